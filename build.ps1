@@ -6,9 +6,15 @@ param (
     [switch]$Tiny = $defaults.Tiny,
     [switch]$MinifyShaders = $defaults.MinifyShaders,
     [switch]$Sound = $defaults.Sound,
+    [switch]$CpuMusic = $defaults.CpuMusic,
     [switch]$Fullscreen = $defaults.Fullscreen,
     [int]$XRes = $defaults.XRes,
     [int]$YRes = $defaults.YRes,
+    # Swap interval: 1 vsync, 0 no vsync, -1 adaptive vsync
+    [ValidateSet(-1, 0, 1)]
+    [int]$SwapInterval = 1,
+    # Frame rate limit of the playback, 0 for none
+    [int]$Framerate = 0,
     [string]$OutName = $defaults.OutName,
 
     [switch]$NoExe,
@@ -18,6 +24,30 @@ param (
     [int]$CrinklerTries = 0,
 
     [switch]$Capture,
+    # Number of processes capturing segments of the timeline in parallel
+    [int]$Segments = 1,
+    # Pipe RGB frames to ffmpeg instead of converting them to YUV 4:2:0
+    [switch]$RgbCapture,
+    # Convert frames to YUV 4:2:0 on the CPU after readback instead of on the GPU
+    [switch]$CpuYuv,
+    # Sub-frames averaged per captured frame, for motion blur
+    [int]$Samples = 1,
+    # Capture rendering resolution factor, downsampled to XRes x YRes
+    [int]$Supersampling = 1,
+    # Frames in flight between rendering, readback and encoding, 1 for
+    # synchronous readback
+    [int]$CaptureBuffers = 3,
+    [switch]$Profile,
+    [switch]$Bench,
+    [switch]$CpuRender,
+    # Replace the image by a false color of the raymarching cost per pixel
+    [switch]$Heatmap,
+    # Scale the rendering resolution to keep the GPU time of the frames
+    # around RESOLUTION_BUDGET (config.h)
+    [switch]$DynamicResolution,
+    # Pixels raymarched per frame: 1 out of 1 (all), 2 (checkerboard) or 4
+    [ValidateSet(1, 2, 4)]
+    [int]$Interleave = 1,
     [switch]$VideoOnly,
     [switch]$SoundOnly
 )
@@ -32,6 +62,7 @@ $buildDir = 'obj' # Output directory for object files
 $cacheDir = 'cache' # Directory for cached build files
 $disasmDir = 'dis' # Output directory of disasembled files
 $shadersDir = "$sourceDir/shaders"
+$linuxDir = "$sourceDir/linux" # Headless Linux backend, built by build.sh
 $shadersSourceFile = "$sourceDir/shaders.c"
 
 $infoColor = "Cyan"
@@ -91,6 +122,16 @@ if($Capture) { # Capture build
     $Tiny = $false
     $Fullscreen = $false
 }
+elseif($Bench) { # Benchmark build, renders offscreen without music
+    $HasVideo = $true
+    $Tiny = $false
+    $Fullscreen = $false
+}
+elseif($Profile) { # Profiling build, needs the C runtime
+    $HasVideo = $true
+    $HasSound = $Sound
+    $Tiny = $false
+}
 elseif($Tiny) { # Tiny build (uses crinkler)
     $DebugBuild = $false
     $HasVideo = $true
@@ -107,16 +148,28 @@ else {
     $HasSound = $Sound
     $MinifyShaders = $true
 }
+if($Heatmap) { # Logs the cost statistics, needs the C runtime
+    $Tiny = $false
+}
 
 # Print option summary
 Write-Host "DebugBuild:    $DebugBuild"
 Write-Host "Tiny:          $Tiny"
+Write-Host "Profile:       $Profile"
+Write-Host "Bench:         $Bench"
 Write-Host "Fullscreen:    $Fullscreen"
 Write-Host "MinifyShaders: $MinifyShaders"
+Write-Host "SwapInterval:  $SwapInterval"
+Write-Host "Framerate:     $Framerate"
 Write-Host "XRes:          $XRes"
 Write-Host "YRes:          $YRes"
 Write-Host "HasSound:      $HasSound"
 Write-Host "HasVideo:      $HasVideo"
+Write-Host "CpuMusic:      $CpuMusic"
+Write-Host "CpuRender:     $CpuRender"
+Write-Host "Heatmap:       $Heatmap"
+Write-Host "DynamicRes:    $DynamicResolution"
+Write-Host "Interleave:    $Interleave"
 Write-Host ""
 
 # Utility functions to test if a given file needs to be updated based
@@ -180,6 +233,22 @@ $compileOptions = @(
 
 if($Capture) {
     $compileOptions += '/DCAPTURE'
+    $compileOptions += "/DCAPTURE_SEGMENTS=$Segments"
+    $compileOptions += "/DCAPTURE_SAMPLES=$Samples"
+    $compileOptions += "/DCAPTURE_SUPERSAMPLING=$Supersampling"
+    $compileOptions += "/DCAPTURE_BUFFERS=$CaptureBuffers"
+    if($RgbCapture) {
+        $compileOptions += '/DCAPTURE_YUV=0'
+    }
+    elseif($CpuYuv) {
+        $compileOptions += '/DCAPTURE_YUV=CAPTURE_YUV_CPU'
+    }
+}
+if($Profile) {
+    $compileOptions += '/DPROFILE'
+}
+if($Bench) {
+    $compileOptions += '/DBENCH'
 }
 if($DebugBuild) {
     $compileOptions += '/DDEBUG'
@@ -198,12 +267,27 @@ if($HasVideo) {
 if ($HasSound) {
     $compileOptions += '/DSOUND'
 }
+if ($CpuMusic) {
+    $compileOptions += '/DCPU_MUSIC'
+}
+if ($CpuRender) {
+    $compileOptions += '/DCPU_RENDER'
+}
+if ($Heatmap) {
+    $compileOptions += '/DHEATMAP'
+}
+if ($DynamicResolution) {
+    $compileOptions += '/DDYNAMIC_RESOLUTION'
+}
 if($Fullscreen) {
     $compileOptions += '/DFULLSCREEN'
 }
 if($MinifyShaders) {
     $compileOptions += '/DMINIFIED_SHADERS'
 }
+$compileOptions += "/DSWAP_INTERVAL=$SwapInterval"
+$compileOptions += "/DTARGET_FRAMERATE=$Framerate"
+$compileOptions += "/DINTERLEAVE=$Interleave"
 $compileOptions += "/DXRES=$XRes"
 $compileOptions += "/DYRES=$YRes"
 
@@ -222,8 +306,10 @@ if($Disasm) {
 if (Test-Path $shadersSourceFile) {
     $shadersSourceFile = (Resolve-Path -Path $shadersSourceFile).Path
 }
+$linuxPath = (Resolve-Path -Path $linuxDir).Path
 $sourceFiles = Get-ChildItem -Path $sourceDir -Filter "*.c" -Recurse `
                 | Where-Object { $_.FullName -ne $shadersSourceFile } `
+                | Where-Object { $_.DirectoryName -ne $linuxPath } `
                 | ForEach-Object {$_.FullName}
 
 if ($MinifyShaders -and (Test-Path $shadersSourceFile)) {
@@ -345,6 +431,9 @@ if(-not $NoExe) {
     if($Capture) {
         $outFile = "capture_$outFile"
     }
+    elseif($Bench) {
+        $outFile = "bench_$outFile"
+    }
 
     # Link
     if ($Tiny) {
@@ -374,7 +463,7 @@ if(-not $NoExe) {
         if ($DebugBuild) {
             $linkOptions += "/DEBUG"
         }
-        if ($Capture) {
+        if ($Capture -or $Bench) {
             $linkOptions += "/SUBSYSTEM:CONSOLE"
             $linkOptions += "/ENTRY:wWinMainCRTStartup"
         }
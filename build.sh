@@ -0,0 +1,196 @@
+#!/usr/bin/env bash
+# Headless Linux build (EGL, no window), see the README.
+#
+# Usage: ./build.sh [config.json] [options]
+#
+# Reads the same JSON configurations as build.ps1. Tiny, Fullscreen and
+# MinifyShaders do not apply here: shaders are always loaded from
+# src/shaders at runtime, so run the executable from the repository root.
+#
+# Extra compiler flags can be passed with CFLAGS, e.g. CFLAGS=-mavx2 to
+# vectorize the CPU synthesizer over 8 samples instead of 4.
+#
+# Options:
+#   -Capture, -VideoOnly, -SoundOnly  same as build.ps1
+#   -CpuMusic, -CpuRender, -Heatmap   same as build.ps1
+#   -DynamicResolution                same as build.ps1
+#   -Profile, -Bench                  same as build.ps1
+#   -SwapInterval N, -Framerate N     same as build.ps1
+#   -Interleave N                     same as build.ps1
+#   -Segments N, -RgbCapture, -CpuYuv same as build.ps1
+#   -Samples N, -Supersampling N      same as build.ps1
+#   -CaptureBuffers N                 same as build.ps1
+#   -XRes N, -YRes N                  override the configuration resolution
+#   -OutName NAME                     override the executable name
+#   -Clean                            remove build outputs
+
+set -e
+
+config="./debug.json"
+if [[ $# -gt 0 && "$1" != -* ]]; then
+    config="$1"
+    shift
+fi
+
+# Minimal JSON reader for the flat configuration files
+config_value() {
+    sed -n "s/.*\"$1\"[[:space:]]*:[[:space:]]*\"\{0,1\}\([^\",}]*\)\"\{0,1\}.*/\1/p" "$config" | tr -d '[:space:]'
+}
+
+DebugBuild=$(config_value DebugBuild)
+Sound=$(config_value Sound)
+CpuMusic=$(config_value CpuMusic)
+CpuRender=false
+Heatmap=false
+DynamicResolution=false
+SwapInterval=1
+Segments=1
+Samples=1
+Supersampling=1
+CaptureBuffers=3
+Framerate=0
+Interleave=1
+XRes=$(config_value XRes)
+YRes=$(config_value YRes)
+OutName=$(config_value OutName)
+Capture=false
+RgbCapture=false
+CpuYuv=false
+Profile=false
+Bench=false
+VideoOnly=false
+SoundOnly=false
+
+while [[ $# -gt 0 ]]; do
+    case "$1" in
+        -Capture) Capture=true ;;
+        -RgbCapture) RgbCapture=true ;;
+        -CpuYuv) CpuYuv=true ;;
+        -VideoOnly) VideoOnly=true ;;
+        -SoundOnly) SoundOnly=true ;;
+        -CpuMusic) CpuMusic=true ;;
+        -CpuRender) CpuRender=true ;;
+        -Heatmap) Heatmap=true ;;
+        -DynamicResolution) DynamicResolution=true ;;
+        -Profile) Profile=true ;;
+        -Bench) Bench=true ;;
+        -SwapInterval) SwapInterval="$2"; shift ;;
+        -Segments) Segments="$2"; shift ;;
+        -Samples) Samples="$2"; shift ;;
+        -Supersampling) Supersampling="$2"; shift ;;
+        -CaptureBuffers) CaptureBuffers="$2"; shift ;;
+        -Framerate) Framerate="$2"; shift ;;
+        -Interleave) Interleave="$2"; shift ;;
+        -XRes) XRes="$2"; shift ;;
+        -YRes) YRes="$2"; shift ;;
+        -OutName) OutName="$2"; shift ;;
+        -Clean)
+            echo "Cleaning build files"
+            rm -f "./$OutName" "./capture_$OutName" "./bench_$OutName"
+            exit 0 ;;
+        *) echo "Unknown option: $1" >&2; exit 1 ;;
+    esac
+    shift
+done
+
+sourceDir="src"
+
+# Option selection logic, same as build.ps1
+HasVideo=true
+HasSound=$Sound
+if $Capture; then
+    HasSound=true
+    if $VideoOnly; then
+        HasSound=false
+    elif $SoundOnly; then
+        HasVideo=false
+    fi
+elif $Bench; then
+    HasSound=false
+fi
+
+echo "DebugBuild:    $DebugBuild"
+echo "Profile:       $Profile"
+echo "Bench:         $Bench"
+echo "XRes:          $XRes"
+echo "YRes:          $YRes"
+echo "SwapInterval:  $SwapInterval"
+echo "Framerate:     $Framerate"
+echo "HasSound:      $HasSound"
+echo "HasVideo:      $HasVideo"
+echo "CpuMusic:      ${CpuMusic:-false}"
+echo "CpuRender:     $CpuRender"
+echo "Heatmap:       $Heatmap"
+echo "DynamicRes:    $DynamicResolution"
+echo "Interleave:    $Interleave"
+echo ""
+
+compileOptions=(-std=gnu11 -O2 -I"$sourceDir")
+if $Capture; then
+    compileOptions+=(-DCAPTURE "-DCAPTURE_SEGMENTS=$Segments")
+    compileOptions+=("-DCAPTURE_SAMPLES=$Samples" "-DCAPTURE_SUPERSAMPLING=$Supersampling")
+    compileOptions+=("-DCAPTURE_BUFFERS=$CaptureBuffers")
+    if $RgbCapture; then
+        compileOptions+=(-DCAPTURE_YUV=0)
+    elif $CpuYuv; then
+        compileOptions+=(-DCAPTURE_YUV=CAPTURE_YUV_CPU)
+    fi
+fi
+if $Profile; then
+    compileOptions+=(-DPROFILE)
+fi
+if $Bench; then
+    compileOptions+=(-DBENCH)
+fi
+if [[ "$DebugBuild" == "true" ]]; then
+    compileOptions+=(-DDEBUG -g)
+fi
+if $HasVideo; then
+    compileOptions+=(-DVIDEO)
+fi
+if [[ "$HasSound" == "true" ]]; then
+    compileOptions+=(-DSOUND)
+fi
+if [[ "$CpuMusic" == "true" ]]; then
+    compileOptions+=(-DCPU_MUSIC)
+fi
+if $CpuRender; then
+    compileOptions+=(-DCPU_RENDER)
+fi
+if $Heatmap; then
+    compileOptions+=(-DHEATMAP)
+fi
+if $DynamicResolution; then
+    compileOptions+=(-DDYNAMIC_RESOLUTION)
+fi
+compileOptions+=("-DSWAP_INTERVAL=$SwapInterval" "-DTARGET_FRAMERATE=$Framerate")
+compileOptions+=("-DINTERLEAVE=$Interleave")
+compileOptions+=("-DXRES=$XRes" "-DYRES=$YRes")
+
+# Shared sources, the Win32 specific ones are replaced by src/linux
+sourceFiles=(
+    "$sourceDir/gl_functions.c"
+    "$sourceDir/intro.c"
+    "$sourceDir/intro_cpu.c"
+    "$sourceDir/music.c"
+    "$sourceDir/music_cpu.c"
+    "$sourceDir/capture.c"
+    "$sourceDir/profile.c"
+    "$sourceDir/bench.c"
+    "$sourceDir/pacing.c"
+    "$sourceDir/params.c"
+    "$sourceDir/reload.c"
+    "$sourceDir"/linux/*.c
+)
+
+outFile="$OutName"
+if $Capture; then
+    outFile="capture_$outFile"
+elif $Bench; then
+    outFile="bench_$outFile"
+fi
+
+echo "Compile options: ${compileOptions[*]}"
+${CC:-cc} "${compileOptions[@]}" $CFLAGS "${sourceFiles[@]}" -o "$outFile" -lEGL -lGL -lpthread -lm
+
+echo "Output file: $outFile"
@@ -0,0 +1,204 @@
+#ifdef BENCH
+
+#include "platform.h"
+#include <math.h>
+#include <GL/gl.h>
+#include "gl_functions.h"
+#include "config.h"
+#include "intro.h"
+#include "utils.h"
+#include "profile.h"
+
+
+#define NUM_FRAMES (INTRO_DURATION*CAPTURE_FRAMERATE)
+
+// Frames rendered before timing, shader compilation and first use costs
+// are not part of the measure
+#define WARMUP_FRAMES 3
+
+static float frameTimes[NUM_FRAMES]; // ms
+
+// Calls timed by the GL function table microbenchmark
+#define NUM_GL_CALLS 100000
+
+// Compares GL calls resolved by name at every call, as all modern GL
+// functions were before the function table, with calls through the table
+static void bench_gl_functions(void) {
+    GLint program; // left current by intro_do
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    double startTime = get_time();
+    for(int i = 0; i < NUM_GL_CALLS; i++) {
+        ((PFNGLUSEPROGRAMPROC)wglGetProcAddress("glUseProgram"))(program);
+    }
+    double lookupTime = (get_time() - startTime) / NUM_GL_CALLS;
+
+    startTime = get_time();
+    for(int i = 0; i < NUM_GL_CALLS; i++) {
+        glUseProgram(program);
+    }
+    double tableTime = (get_time() - startTime) / NUM_GL_CALLS;
+    glFinish();
+
+    // intro_do calls glBindBufferRange and glUseProgram
+    log_printf("glUseProgram: %.1f ns per call resolved by name, %.1f ns through the table, "
+        "%.2f us saved per frame\n",
+        lookupTime*1e9, tableTime*1e9, 2.*(lookupTime - tableTime)*1e6);
+}
+
+#ifdef CPU_RENDER
+// Channel difference between the CPU and GPU renderings above which a
+// pixel mismatches, and ratio of mismatching pixels accepted: pixels on
+// the silhouette may flip with float rounding
+#define CPU_RENDER_TOLERANCE 8
+#define CPU_RENDER_MAX_MISMATCHES 1e-3
+
+static GLubyte gpuPixels[3*XRES*YRES];
+static GLubyte cpuPixels[3*XRES*YRES];
+
+// Renders one frame per second on the CPU, compares it to the shader's
+// and reports the CPU raymarcher throughput
+static void bench_cpu(void) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    double cpuTime = 0.;
+    int maxError = 0;
+    int maxMismatches = 0;
+    for(int i = 0; i < NUM_FRAMES; i += CAPTURE_FRAMERATE) {
+        GLfloat time = (GLfloat)i / (GLfloat)CAPTURE_FRAMERATE;
+        intro_do(time);
+        glReadPixels(0, 0, XRES, YRES, GL_RGB, GL_UNSIGNED_BYTE, gpuPixels);
+
+        double startTime = get_time();
+        intro_render_cpu(cpuPixels, time);
+        cpuTime += get_time() - startTime;
+
+        int mismatches = 0;
+        for(int p = 0; p < XRES*YRES; p++) {
+            int error = 0;
+            for(int c = 3*p; c < 3*p + 3; c++) {
+                int e = cpuPixels[c] - gpuPixels[c];
+                e = e < 0 ? -e : e;
+                error = e > error ? e : error;
+            }
+            maxError = error > maxError ? error : maxError;
+            mismatches += error > CPU_RENDER_TOLERANCE;
+        }
+        maxMismatches = mismatches > maxMismatches ? mismatches : maxMismatches;
+    }
+
+    int numFrames = (NUM_FRAMES + CAPTURE_FRAMERATE - 1) / CAPTURE_FRAMERATE;
+    log_printf("CPU render: %d frames in %.3fs, %.2f Mrays/s, %.1f ms/frame\n",
+        numFrames, cpuTime, (double)numFrames*XRES*YRES / cpuTime * 1e-6, cpuTime / numFrames * 1e3);
+    log_printf("CPU render: max channel error %d, up to %d mismatching pixels per frame\n",
+        maxError, maxMismatches);
+    if(maxMismatches > CPU_RENDER_MAX_MISMATCHES*XRES*YRES) {
+        MessageBox(NULL, "CPU rendering differs from shader.frag.", "Error", MB_OK);
+        ExitProcess(1);
+    }
+}
+#endif
+
+#if INTERLEAVE > 1
+static GLubyte interleavedPixels[3*XRES*YRES];
+static GLubyte referencePixels[3*XRES*YRES];
+static float referenceTimes[NUM_FRAMES]; // ms
+
+// Renders the frames interleaved again, each one followed by the same
+// frame rendered fully, and reports the quality of the interleaved frames
+// as their PSNR and the frame times of the full rendering
+static void bench_interleave(void) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    double squareErrorSum = 0.;
+    double minPsnr = INFINITY;
+    int minPsnrFrame = 0;
+    for(int i = 0; i < NUM_FRAMES; i++) {
+        GLfloat time = (GLfloat)i / (GLfloat)CAPTURE_FRAMERATE;
+        intro_do(time);
+        glReadPixels(0, 0, XRES, YRES, GL_RGB, GL_UNSIGNED_BYTE, interleavedPixels);
+
+        double startTime = get_time();
+        intro_do_reference(time);
+        glFinish();
+        referenceTimes[i] = (float)((get_time() - startTime) * 1e3);
+        glReadPixels(0, 0, XRES, YRES, GL_RGB, GL_UNSIGNED_BYTE, referencePixels);
+
+        double squareError = 0.;
+        for(int c = 0; c < 3*XRES*YRES; c++) {
+            int e = interleavedPixels[c] - referencePixels[c];
+            squareError += e*e;
+        }
+        squareError /= 3*XRES*YRES;
+        squareErrorSum += squareError;
+        double psnr = 10.*log10(255.*255. / squareError); // infinite for identical frames
+        if(psnr < minPsnr) {
+            minPsnr = psnr;
+            minPsnrFrame = i;
+        }
+    }
+
+    // Over the whole sequence, then of the worst frame
+    double psnr = 10.*log10(255.*255. / (squareErrorSum / NUM_FRAMES));
+    log_printf("Interleave %d: PSNR %.2f dB, min %.2f dB at %.2fs\n",
+        INTERLEAVE, psnr, minPsnr, (float)minPsnrFrame / CAPTURE_FRAMERATE);
+    log_printf("Full rendering ms/frame p50 %.3f  p95 %.3f\n",
+        percentile(referenceTimes, NUM_FRAMES, 50.f), percentile(referenceTimes, NUM_FRAMES, 95.f));
+}
+#endif
+
+void run_bench(void) {
+    // Render offscreen, there is no window to present to and the frames
+    // are neither throttled by vsync nor discarded by pixel ownership tests
+    GLuint fboTexture, fbo;
+    glGenTextures(1, &fboTexture);
+    glBindTexture(GL_TEXTURE_2D, fboTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, XRES, YRES, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture, 0);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        MessageBox(NULL, "FBO creation failed.", "Error", MB_OK);
+        ExitProcess(1);
+    }
+    glViewport(0, 0, XRES, YRES);
+
+    for(int i = 0; i < WARMUP_FRAMES; i++) {
+        intro_do(0.f);
+    }
+    glFinish();
+
+    // Each frame is waited for, its time is the full CPU and GPU latency
+    double startTime = get_time();
+    double frameStart = startTime;
+    for(int i = 0; i < NUM_FRAMES; i++) {
+        intro_do((GLfloat)i / (GLfloat)CAPTURE_FRAMERATE);
+        glFinish();
+        double frameEnd = get_time();
+        frameTimes[i] = (float)((frameEnd - frameStart) * 1e3);
+        frameStart = frameEnd;
+    }
+    double totalTime = get_time() - startTime;
+    #ifdef HEATMAP
+    heatmap_report();
+    #endif
+    #ifdef DYNAMIC_RESOLUTION
+    resolution_report();
+    #endif
+
+    float p50 = percentile(frameTimes, NUM_FRAMES, 50.f);
+    float p95 = percentile(frameTimes, NUM_FRAMES, 95.f);
+    float p99 = percentile(frameTimes, NUM_FRAMES, 99.f);
+    log_printf("Bench %dx%d: %d frames in %.3fs, %.2f fps\n",
+        XRES, YRES, NUM_FRAMES, totalTime, NUM_FRAMES / totalTime);
+    log_printf("ms/frame min %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+        frameTimes[0], p50, p95, p99, frameTimes[NUM_FRAMES - 1]);
+
+    bench_gl_functions();
+
+    #ifdef CPU_RENDER
+    bench_cpu();
+    #endif
+    #if INTERLEAVE > 1
+    bench_interleave();
+    #endif
+}
+
+#endif
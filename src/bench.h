@@ -0,0 +1,6 @@
+#pragma once
+
+// Offline benchmark, enabled with the BENCH build flag.
+// Renders the INTRO_DURATION*CAPTURE_FRAMERATE frames of the capture at
+// their fixed timestamps as fast as possible, then prints the throughput.
+void run_bench(void);
@@ -1,89 +1,342 @@
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#ifdef CAPTURE
+
+#include "platform.h"
 #include <stdio.h>
 #include <GL/gl.h>
-#include "glext.h"
+#include "gl_functions.h"
 #include "config.h"
 #include "utils.h"
 #include "music.h"
+#include "simd.h"
+
+
+#if CAPTURE_BUFFERS < 1
+#error "CAPTURE_BUFFERS must be at least 1"
+#endif
+
+#if CAPTURE_YUV
+#if XRES % 2 || YRES % 2
+#error "YUV 4:2:0 captures need an even resolution"
+#endif
+// Frames are flipped and converted to planar YUV 4:2:0 (1.5 bytes per pixel)
+// before being piped to ffmpeg
+#define FRAME_SIZE (XRES*YRES*3/2)
+#define FFMPEG_INPUT "-f rawvideo -pix_fmt yuv420p -s %dx%d -r %d -i - "
+#define FFMPEG_VIDEO "-c:v libx264 -colorspace bt709 -color_primaries bt709 -color_trc bt709 -color_range tv "
+#else
+#define FRAME_SIZE (3*XRES*YRES)
+#define FFMPEG_INPUT "-f rawvideo -pix_fmt rgb24 -s %dx%d -r %d -i - "
+#define FFMPEG_VIDEO "-vf vflip -c:v libx264 -pix_fmt yuv420p "
+#endif
+
+#if CAPTURE_YUV == CAPTURE_YUV_GPU
+#if XRES % 8
+#error "GPU YUV conversion needs a width multiple of 8, use CAPTURE_YUV_CPU"
+#endif
+// The conversion shader writes frames in their final layout into the
+// readback buffers, nothing is left to do on the CPU
+#define READ_FRAME_SIZE FRAME_SIZE
+#elif CAPTURE_YUV == CAPTURE_YUV_CPU
+// Frames are read back as BGRA, the native layout of most drivers
+#define READ_FORMAT GL_BGRA
+#define READ_FRAME_SIZE (4*XRES*YRES)
+#else
+#define READ_FORMAT GL_RGB
+#define READ_FRAME_SIZE FRAME_SIZE
+#endif
 
-
-#define glGenFramebuffers ((PFNGLGENFRAMEBUFFERSPROC)wglGetProcAddress("glGenFramebuffers"))
-#define glBindFramebuffer ((PFNGLBINDFRAMEBUFFERPROC)wglGetProcAddress("glBindFramebuffer"))
-#define glFramebufferTexture2D ((PFNGLFRAMEBUFFERTEXTURE2DPROC)wglGetProcAddress("glFramebufferTexture2D"))
-#define glCheckFramebufferStatus ((PFNGLCHECKFRAMEBUFFERSTATUSPROC)wglGetProcAddress("glCheckFramebufferStatus"))
-
-#define FRAME_SIZE 3*XRES*YRES
-
-static GLubyte frame[FRAME_SIZE];
 static GLuint fboTexture;
 static GLuint fbo;
 
+#if CAPTURE_ACCUMULATE
+#define SAMPLE_XRES (XRES*CAPTURE_SUPERSAMPLING)
+#define SAMPLE_YRES (YRES*CAPTURE_SUPERSAMPLING)
+
+// Sub-frames are rendered into their own framebuffer, then box filtered
+// and summed in linear space into a float texture. The last sample of a
+// frame writes the average into fboTexture, captured as usual.
+static GLuint sampleTexture;
+static GLuint sampleFbo;
+static GLuint accumulationTexture;
+static GLuint accumulateShader;
+
+static const char* accumulateShaderSource =
+    "#version 430\n"
+    "layout(local_size_x = 8, local_size_y = 8) in;\n"
+    "layout(binding = 0) uniform sampler2D samples;\n"
+    "layout(rgba32f, binding = 0) uniform image2D accumulation;\n"
+    "layout(rgba8, binding = 1) writeonly uniform image2D frame;\n"
+    "layout(location = 0) uniform vec4 params;\n" // sample, number of samples
+    "void main() {\n"
+    "    ivec2 p = ivec2(gl_GlobalInvocationID.xy);\n"
+    "    if(any(greaterThanEqual(p, imageSize(frame)))) return;\n"
+    "    int k = textureSize(samples, 0).x / imageSize(frame).x;\n"
+    "    vec3 c = vec3(0.);\n"
+    "    for(int y = 0; y < k; y++)\n"
+    "        for(int x = 0; x < k; x++)\n"
+    "            c += pow(texelFetch(samples, p*k + ivec2(x, y), 0).rgb, vec3(2.2));\n"
+    "    c /= float(k*k);\n"
+    "    if(params.x > 0.) c += imageLoad(accumulation, p).rgb;\n"
+    "    if(params.x < params.y - 1.) imageStore(accumulation, p, vec4(c, 1.));\n"
+    "    else imageStore(frame, p, vec4(pow(c / params.y, vec3(1. / 2.2)), 1.));\n"
+    "}\n";
+#endif
+
 static HANDLE ffmpegStdinWrite;
-static PROCESS_INFORMATION ffmpegPi;
+static HANDLE ffmpegProcess;
+
+// Frames are read back asynchronously into a ring of persistently mapped
+// buffers (pixel pack buffers, or storage buffers written by the conversion
+// shader), then written to ffmpeg by a separate thread: the readback of a
+// frame overlaps with the rendering of the next one, and encoding overlaps
+// with both. With a single buffer, each frame is read back and written
+// before the next one is rendered, without the writer thread.
+static GLuint packBuffers[CAPTURE_BUFFERS];
+static GLubyte* mappedFrames[CAPTURE_BUFFERS];
+static GLsync readFences[CAPTURE_BUFFERS];
+static int numFrames; // number of frames read back
+
+#if CAPTURE_BUFFERS > 1
+static HANDLE writerThread;
+static HANDLE freeBuffers; // counts the pack buffers available for readback
+static HANDLE filledBuffers; // counts the frames ready to be written
+static volatile int numPostedFrames; // frames handed to the writer thread
+#endif
+
+static double startTime;
+
+#if CAPTURE_YUV == CAPTURE_YUV_GPU
+static GLuint yuvShader;
+
+// Flips and converts the frame to planar YUV 4:2:0 with the same fixed point
+// math as the CPU conversion. Each invocation converts 8x2 pixels to whole
+// words: 2 words of luma per row and 1 word in each chroma plane.
+static const char* yuvShaderSource =
+    "#version 430\n"
+    "layout(local_size_x = 8, local_size_y = 8) in;\n"
+    "layout(binding = 0) uniform sampler2D frame;\n"
+    "layout(std430, binding = 0) writeonly buffer Yuv { uint yuv[]; };\n"
+    "uvec3 texel(ivec2 p) {\n"
+    "    p.y = textureSize(frame, 0).y - 1 - p.y;\n"
+    "    return uvec3(round(texelFetch(frame, p, 0).rgb * 255.));\n"
+    "}\n"
+    "uint luma(uvec3 c) {\n"
+    "    return (47u*c.r + 157u*c.g + 16u*c.b + 4224u) >> 8;\n"
+    "}\n"
+    "void main() {\n"
+    "    ivec2 size = textureSize(frame, 0);\n"
+    "    ivec2 p = ivec2(gl_GlobalInvocationID.xy) * ivec2(8, 2);\n"
+    "    if(p.x >= size.x || p.y >= size.y) return;\n"
+    "    uint y0[2] = uint[2](0u, 0u);\n"
+    "    uint y1[2] = uint[2](0u, 0u);\n"
+    "    uint u = 0u, v = 0u;\n"
+    "    for(int i = 0; i < 4; i++) {\n"
+    "        ivec2 q = p + ivec2(2*i, 0);\n"
+    "        uvec3 a = texel(q), b = texel(q + ivec2(1, 0));\n"
+    "        uvec3 c = texel(q + ivec2(0, 1)), d = texel(q + ivec2(1, 1));\n"
+    "        y0[i/2] |= (luma(a) | luma(b) << 8) << 16*(i & 1);\n"
+    "        y1[i/2] |= (luma(c) | luma(d) << 8) << 16*(i & 1);\n"
+    "        uvec3 m = (a + b + c + d + 2u) >> 2;\n"
+    "        u |= ((112u*m.b + 32896u - 26u*m.r - 86u*m.g) >> 8) << 8*i;\n"
+    "        v |= ((112u*m.r + 32896u - 102u*m.g - 10u*m.b) >> 8) << 8*i;\n"
+    "    }\n"
+    "    int row = (p.y*size.x + p.x)/4;\n"
+    "    yuv[row] = y0[0];\n"
+    "    yuv[row + 1] = y0[1];\n"
+    "    yuv[row + size.x/4] = y1[0];\n"
+    "    yuv[row + size.x/4 + 1] = y1[1];\n"
+    "    int chroma = size.x*size.y/4 + (p.y/2*size.x/2 + p.x/2)/4;\n"
+    "    yuv[chroma] = u;\n"
+    "    yuv[chroma + size.x*size.y/16] = v;\n"
+    "}\n";
+#endif
+
+#if CAPTURE_YUV == CAPTURE_YUV_CPU
+static GLubyte yuvFrame[FRAME_SIZE];
+static double conversionTime;
+
+// BT.709 limited range conversion in 8 bits fixed point, with the offsets
+// and rounding folded in. Results always fit in unsigned 16 bits.
+#define LUMA(r, g, b) ((47*(r) + 157*(g) + 16*(b) + 128 + (16 << 8)) >> 8)
+#define CHROMA_U(r, g, b) ((112*(b) - 26*(r) - 86*(g) + 128 + (128 << 8)) >> 8)
+#define CHROMA_V(r, g, b) ((112*(r) - 102*(g) - 10*(b) + 128 + (128 << 8)) >> 8)
+
+// Channels of 2*VWIDTH BGRA pixels, in 16 bits lanes
+static void load_bgra(const GLubyte* src, vint* r, vint* g, vint* b) {
+    vint p0 = viload(src);
+    vint p1 = viload(src + 4*VWIDTH);
+    vint mask = viset(0xFF);
+    *b = vipack32(viand(p0, mask), viand(p1, mask));
+    *g = vipack32(viand(visrli(p0, 8), mask), viand(visrli(p1, 8), mask));
+    *r = vipack32(viand(visrli(p0, 16), mask), viand(visrli(p1, 16), mask));
+}
+
+// Same as LUMA(), lanes wrap around but the result is exact
+static vint vluma(vint r, vint g, vint b) {
+    vint y = viadd16(vimul16(r, viset16(47)), vimul16(g, viset16(157)));
+    y = viadd16(y, vimul16(b, viset16(16)));
+    return visrli16(viadd16(y, viset16(128 + (16 << 8))), 8);
+}
 
+// Same as CHROMA_U() and CHROMA_V()
+static vint vchroma(vint a, vint b, vint c, short ka, short kb, short kc) {
+    vint x = visub16(vimul16(a, viset16(ka)), vimul16(b, viset16(kb)));
+    x = visub16(x, vimul16(c, viset16(kc)));
+    return visrli16(viadd16(x, viset16((short)(128 + (128 << 8)))), 8);
+}
 
-void start_capture(void) {
-    SECURITY_ATTRIBUTES sa = {0};
-    sa.nLength = sizeof(sa);
-    sa.bInheritHandle = TRUE;
+// Rounded average of 2x2 blocks, from the sums of two rows of 4*VWIDTH pixels
+static vint vblock_average(vint left, vint right) {
+    vint ones = viset16(1);
+    vint sum = vipack32(vimadd16(left, ones), vimadd16(right, ones));
+    return visrli16(viadd16(sum, viset16(2)), 2);
+}
 
-    HANDLE stdinRead = NULL;
-    if(!CreatePipe(&stdinRead, &ffmpegStdinWrite, &sa, 0)) {
-        ERROR_EXIT();
+// Converts a BGRA frame read back bottom row first to planar YUV 4:2:0,
+// top row first. Two rows are converted at once, for the chroma of 2x2
+// blocks, 4*VWIDTH pixels at a time.
+static void convert_frame(GLubyte* dst, const GLubyte* src) {
+    double conversionStart = get_time();
+    GLubyte* dstU = dst + XRES*YRES;
+    GLubyte* dstV = dstU + XRES*YRES/4;
+    for(int row = 0; row < YRES; row += 2) {
+        const GLubyte* src0 = src + 4*XRES*(YRES - 1 - row);
+        const GLubyte* src1 = src0 - 4*XRES;
+        GLubyte* y0 = dst + XRES*row;
+        GLubyte* y1 = y0 + XRES;
+        GLubyte* u = dstU + XRES/2*(row/2);
+        GLubyte* v = dstV + XRES/2*(row/2);
+
+        int x = 0;
+        for(; x + 4*VWIDTH <= XRES; x += 4*VWIDTH) {
+            // Left and right halves of both rows
+            vint r[4], g[4], b[4];
+            load_bgra(src0 + 4*x, &r[0], &g[0], &b[0]);
+            load_bgra(src0 + 4*(x + 2*VWIDTH), &r[1], &g[1], &b[1]);
+            load_bgra(src1 + 4*x, &r[2], &g[2], &b[2]);
+            load_bgra(src1 + 4*(x + 2*VWIDTH), &r[3], &g[3], &b[3]);
+            vistore(y0 + x, vipack16(vluma(r[0], g[0], b[0]), vluma(r[1], g[1], b[1])));
+            vistore(y1 + x, vipack16(vluma(r[2], g[2], b[2]), vluma(r[3], g[3], b[3])));
+
+            vint rc = vblock_average(viadd16(r[0], r[2]), viadd16(r[1], r[3]));
+            vint gc = vblock_average(viadd16(g[0], g[2]), viadd16(g[1], g[3]));
+            vint bc = vblock_average(viadd16(b[0], b[2]), viadd16(b[1], b[3]));
+            vint uc = vchroma(bc, rc, gc, 112, 26, 86);
+            vint vc = vchroma(rc, gc, bc, 112, 102, 10);
+            vistore_half(u + x/2, vipack16(uc, uc));
+            vistore_half(v + x/2, vipack16(vc, vc));
+        }
+        for(; x < XRES; x += 2) { // end of the row
+            const GLubyte* p[4] = {src0 + 4*x, src0 + 4*x + 4, src1 + 4*x, src1 + 4*x + 4};
+            int r = 2, g = 2, b = 2;
+            for(int k = 0; k < 4; k++) {
+                r += p[k][2];
+                g += p[k][1];
+                b += p[k][0];
+            }
+            r >>= 2;
+            g >>= 2;
+            b >>= 2;
+            y0[x] = LUMA(p[0][2], p[0][1], p[0][0]);
+            y0[x + 1] = LUMA(p[1][2], p[1][1], p[1][0]);
+            y1[x] = LUMA(p[2][2], p[2][1], p[2][0]);
+            y1[x + 1] = LUMA(p[3][2], p[3][1], p[3][0]);
+            u[x/2] = CHROMA_U(r, g, b);
+            v[x/2] = CHROMA_V(r, g, b);
+        }
     }
+    conversionTime += get_time() - conversionStart;
+}
+#endif
 
-    if(!SetHandleInformation(ffmpegStdinWrite, HANDLE_FLAG_INHERIT, 0)) {
-        ERROR_EXIT();
+// Video of a segment, numbered from 1
+#define SEGMENT_FILE "capture_%d.mp4"
+#define SEGMENTS_LIST "capture_segments.txt"
+
+// Waits for the readback of a frame
+static void wait_frame(int frame) {
+    GLsync fence = readFences[frame % CAPTURE_BUFFERS];
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+}
+
+#if CAPTURE_BUFFERS > 1
+static DWORD WINAPI writer_thread(LPVOID arg) {
+    for(int frame = 0; ; frame++) {
+        wait_semaphore(filledBuffers);
+        if(frame == numPostedFrames) {
+            return 0; // no more frames, see finish_capture
+        }
+        const GLubyte* pixels = mappedFrames[frame % CAPTURE_BUFFERS];
+        #if CAPTURE_YUV == CAPTURE_YUV_CPU
+        convert_frame(yuvFrame, pixels);
+        release_semaphore(freeBuffers); // the pack buffer is not needed anymore
+        pixels = yuvFrame;
+        #endif
+        if (!write_file(ffmpegStdinWrite, pixels, FRAME_SIZE, NULL)) {
+            ERROR_EXIT();
+        }
+        #if CAPTURE_YUV != CAPTURE_YUV_CPU
+        release_semaphore(freeBuffers);
+        #endif
     }
+}
 
-    STARTUPINFO si = {0};
-    si.cb = sizeof(si);
-    si.dwFlags = STARTF_USESTDHANDLES;
-    si.hStdInput  = stdinRead;
-    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-    si.hStdError  = GetStdHandle(STD_ERROR_HANDLE);
+// Hands a frame over to the writer thread once read back
+static void post_frame(int frame) {
+    wait_frame(frame);
+    numPostedFrames++;
+    release_semaphore(filledBuffers);
+}
+#endif
 
+
+void start_capture(int segment) {
     char cmd[1024];
-    #ifdef SOUND
-    sprintf_s(cmd, sizeof(cmd),
-        "ffmpeg -y "
-        "-f rawvideo -pix_fmt rgb24 -s %dx%d -r %d -i - "
-        "-i \".\\audio.mp3\" "
-        "-map 0:v:0 -map 1:a:0 "
-        "-vf vflip "
-        "-c:v libx264 -pix_fmt yuv420p "
-        "-c:a aac -b:a 192k "
-        "-shortest "
-        "\".\\capture.mp4\"",
-        XRES, YRES, CAPTURE_FRAMERATE);
-    #else
-    sprintf_s(cmd, sizeof(cmd),
-        "ffmpeg -y "
-        "-f rawvideo -pix_fmt rgb24 -s %dx%d -r %d -i - "
-        "-c:v libx264 -pix_fmt yuv420p "
-        "\".\\capture.mp4\"",
-        XRES, YRES, CAPTURE_FRAMERATE);
-    #endif
+    if(segment >= 0) {
+        // Video only, the audio is added when concatenating the segments
+        sprintf_s(cmd, sizeof(cmd),
+            "ffmpeg -y "
+            FFMPEG_INPUT
+            FFMPEG_VIDEO
+            "\"" SEGMENT_FILE "\"",
+            XRES, YRES, CAPTURE_FRAMERATE, segment + 1);
+    } else {
+        #ifdef SOUND
+        sprintf_s(cmd, sizeof(cmd),
+            "ffmpeg -y "
+            FFMPEG_INPUT
+            "-i \"audio.wav\" "
+            "-map 0:v:0 -map 1:a:0 "
+            FFMPEG_VIDEO
+            "-c:a aac -b:a 192k "
+            "-shortest "
+            "\"capture.mp4\"",
+            XRES, YRES, CAPTURE_FRAMERATE);
+        #else
+        sprintf_s(cmd, sizeof(cmd),
+            "ffmpeg -y "
+            FFMPEG_INPUT
+            FFMPEG_VIDEO
+            "\"capture.mp4\"",
+            XRES, YRES, CAPTURE_FRAMERATE);
+        #endif
+    }
 
-    BOOL ok = CreateProcess(
-        NULL, cmd,
-        NULL, NULL,
-        TRUE,
-        CREATE_NO_WINDOW,
-        NULL, NULL,
-        &si, &ffmpegPi);
-    
-    if (!ok) {
+    if(!start_process(cmd, &ffmpegStdinWrite, &ffmpegProcess)) {
         ERROR_EXIT();
     }
 
-    CloseHandle(stdinRead);
-
     // Create texture to render into
     glGenTextures(1, &fboTexture);
     glBindTexture(GL_TEXTURE_2D, fboTexture);
+    #if CAPTURE_ACCUMULATE
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, XRES, YRES, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    #else
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, XRES, YRES, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    #endif
+    // Texel fetches need a complete texture, without mipmaps
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
     // Create FBO
     glGenFramebuffers(1, &fbo);
@@ -96,97 +349,288 @@ void start_capture(void) {
         ExitProcess(1);
     }
 
+    #if CAPTURE_ACCUMULATE
+    glGenTextures(1, &sampleTexture);
+    glBindTexture(GL_TEXTURE_2D, sampleTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SAMPLE_XRES, SAMPLE_YRES, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glGenTextures(1, &accumulationTexture);
+    glBindTexture(GL_TEXTURE_2D, accumulationTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, XRES, YRES, 0, GL_RGBA, GL_FLOAT, NULL);
+
+    // The intro draws into the sample framebuffer, the captured frame is
+    // still read from the first one
+    glGenFramebuffers(1, &sampleFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sampleFbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sampleTexture, 0);
+    if(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        MessageBox(NULL, "FBO creation failed.", "Error", MB_OK);
+        ExitProcess(1);
+    }
+    glViewport(0, 0, SAMPLE_XRES, SAMPLE_YRES);
+
+    glBindImageTexture(0, accumulationTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(1, fboTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    accumulateShader = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, &accumulateShaderSource);
+    if(!check_shader(accumulateShader)) {
+        ExitProcess(1);
+    }
+    #else
+    glViewport(0, 0, XRES, YRES);
+    #endif
+
+    #if CAPTURE_YUV == CAPTURE_YUV_GPU
+    yuvShader = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, &yuvShaderSource);
+    if(!check_shader(yuvShader)) {
+        ExitProcess(1);
+    }
+    #else
     glReadBuffer(GL_COLOR_ATTACHMENT0);
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glViewport(0, 0, XRES, YRES);
+    #endif
+
+    // Create the readback ring, mapped once for the whole capture.
+    // Coherent mapping makes the pixels visible as soon as the fence is signaled.
+    const GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(CAPTURE_BUFFERS, packBuffers);
+    for(int i = 0; i < CAPTURE_BUFFERS; i++) {
+        glNamedBufferStorage(packBuffers[i], READ_FRAME_SIZE, NULL, mapFlags | GL_CLIENT_STORAGE_BIT);
+        mappedFrames[i] = (GLubyte*)glMapNamedBufferRange(packBuffers[i], 0, READ_FRAME_SIZE, mapFlags);
+        if(!mappedFrames[i]) {
+            MessageBox(NULL, "Failed to map readback buffer.", "Error", MB_OK);
+            ExitProcess(1);
+        }
+    }
+
+    #if CAPTURE_BUFFERS > 1
+    freeBuffers = create_semaphore(CAPTURE_BUFFERS);
+    filledBuffers = create_semaphore(0);
+    writerThread = start_thread(writer_thread, NULL);
+    #endif
+
+    startTime = get_time();
 }
 
 void capture_frame(void) {
-    glReadPixels(0, 0, XRES, YRES, GL_RGB, GL_UNSIGNED_BYTE, frame);
-    
-    if (!write_file(ffmpegStdinWrite, frame, FRAME_SIZE, NULL)) {
+    int slot = numFrames % CAPTURE_BUFFERS;
+    #if CAPTURE_BUFFERS > 1
+    wait_semaphore(freeBuffers); // wait for the writer to be done with this slot
+    #endif
+
+    #if CAPTURE_YUV == CAPTURE_YUV_GPU
+    // The converted frame is written straight into the mapped buffer,
+    // the barrier makes the writes visible to the CPU once the fence is signaled
+    glUseProgram(yuvShader);
+    glBindTexture(GL_TEXTURE_2D, fboTexture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, packBuffers[slot]);
+    glDispatchCompute((XRES/8 + 7) / 8, (YRES/2 + 7) / 8, 1);
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    #else
+    // Asynchronous readback, glReadPixels returns without waiting for the GPU
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[slot]);
+    glReadPixels(0, 0, XRES, YRES, READ_FORMAT, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    #endif
+    readFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    #if CAPTURE_BUFFERS > 1
+    // The previous frame's readback is most likely complete by now
+    if(numFrames > 0) {
+        post_frame(numFrames - 1);
+    }
+    #else
+    wait_frame(numFrames);
+    const GLubyte* pixels = mappedFrames[0];
+    #if CAPTURE_YUV == CAPTURE_YUV_CPU
+    convert_frame(yuvFrame, pixels);
+    pixels = yuvFrame;
+    #endif
+    if (!write_file(ffmpegStdinWrite, pixels, FRAME_SIZE, NULL)) {
         ERROR_EXIT();
     }
+    #endif
+    numFrames++;
+}
+
+#if CAPTURE_ACCUMULATE
+void accumulate_sample(int sample) {
+    GLfloat params[4] = {(GLfloat)sample, (GLfloat)CAPTURE_SAMPLES, 0.f, 0.f};
+    glUseProgram(accumulateShader);
+    glUniform4fv(0, 1, params);
+    glBindTexture(GL_TEXTURE_2D, sampleTexture);
+    glDispatchCompute((XRES + 7) / 8, (YRES + 7) / 8, 1);
+    // The next sample reads the accumulation image, and the captured frame
+    // is read by texel fetches or glReadPixels
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
 }
+#endif
 
 void finish_capture(void) {
+    #if CAPTURE_BUFFERS > 1
+    if(numFrames > 0) {
+        post_frame(numFrames - 1);
+    }
+    release_semaphore(filledBuffers); // wakes the writer up without a frame
+    join_thread(writerThread);
+    #endif
+
+    double captureTime = get_time() - startTime;
+    log_printf("Captured %d frames in %.2fs (%.2f fps)\r\n",
+        numFrames, captureTime, numFrames / captureTime);
+    #if CAPTURE_YUV == CAPTURE_YUV_CPU
+    log_printf("YUV 4:2:0 conversion: %.2f ms per frame (%.0f Mpixels/s)\r\n",
+        conversionTime / numFrames * 1e3, (double)XRES*YRES*numFrames / conversionTime * 1e-6);
+    #endif
+
+    for(int i = 0; i < CAPTURE_BUFFERS; i++) {
+        glUnmapNamedBuffer(packBuffers[i]);
+    }
+    glDeleteBuffers(CAPTURE_BUFFERS, packBuffers);
+    #if CAPTURE_BUFFERS > 1
+    delete_semaphore(freeBuffers);
+    delete_semaphore(filledBuffers);
+    #endif
+
     CloseHandle(ffmpegStdinWrite); // EOF to ffmpeg
-    WaitForSingleObject(ffmpegPi.hProcess, INFINITE);
-    
-    DWORD exitCode = 0;
-    GetExitCodeProcess(ffmpegPi.hProcess, &exitCode);
-    if (exitCode != 0) {
+    if (wait_process(ffmpegProcess) != 0) {
         MessageBox(NULL, "Failed to encode video capture.", "Error", MB_OK);
         ExitProcess(1);
     }
-
-    CloseHandle(ffmpegPi.hThread);
-    CloseHandle(ffmpegPi.hProcess);
 }
 
-void save_audio(const float* buffer, DWORD nbBytes) {
-    // Save raw buffer to file
-    HANDLE hFile = CreateFile(
-        ".\\audio.raw",
-        GENERIC_WRITE,
-        0,
-        NULL, 
-        CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
+#if CAPTURE_SEGMENTS > 1
+void capture_segments(void) {
+    startTime = get_time();
 
-    if(hFile == INVALID_HANDLE_VALUE) {
+    char exePath[1024];
+    if(!get_executable_path(exePath, sizeof(exePath))) {
         ERROR_EXIT();
     }
 
-    if (!write_file(hFile, buffer, nbBytes, NULL)) {
-        ERROR_EXIT();
+    // Each segment renders in its own process and GL context, and feeds
+    // its own encoder. Processes are started with their segment number.
+    char cmd[1024 + 64];
+    HANDLE processes[CAPTURE_SEGMENTS];
+    for(int i = 0; i < CAPTURE_SEGMENTS; i++) {
+        sprintf_s(cmd, sizeof(cmd), "\"%s\" %d", exePath, i + 1);
+        if(!start_process(cmd, NULL, &processes[i])) {
+            ERROR_EXIT();
+        }
+    }
+    BOOL failed = FALSE;
+    for(int i = 0; i < CAPTURE_SEGMENTS; i++) {
+        failed |= wait_process(processes[i]) != 0;
+    }
+    if(failed) {
+        MessageBox(NULL, "Failed to capture a segment.", "Error", MB_OK);
+        ExitProcess(1);
     }
+    double renderTime = get_time() - startTime;
 
+    // Lossless concatenation, ffmpeg's concat demuxer copies the H.264
+    // streams of the segments as is
+    HANDLE hFile = create_file(SEGMENTS_LIST);
+    if(hFile == INVALID_HANDLE_VALUE) {
+        ERROR_EXIT();
+    }
+    for(int i = 0; i < CAPTURE_SEGMENTS; i++) {
+        char line[64];
+        int length = sprintf_s(line, sizeof(line), "file '" SEGMENT_FILE "'\n", i + 1);
+        if(!write_file(hFile, line, length, NULL)) {
+            ERROR_EXIT();
+        }
+    }
     CloseHandle(hFile);
 
-    // Run ffmpeg to convert raw to mp3
-    STARTUPINFOA si = {0};
-    si.cb = sizeof(si);
-
-    PROCESS_INFORMATION pi = {0};
-
-    char cmd[1024];
+    #ifdef SOUND
+    sprintf_s(cmd, sizeof(cmd),
+        "ffmpeg -y "
+        "-f concat -safe 0 -i \"" SEGMENTS_LIST "\" "
+        "-i \"audio.wav\" "
+        "-map 0:v:0 -map 1:a:0 "
+        "-c:v copy "
+        "-c:a aac -b:a 192k "
+        "-shortest "
+        "\"capture.mp4\"");
+    #else
     sprintf_s(cmd, sizeof(cmd),
         "ffmpeg -y "
-        "-f f32le -ar %d -ac %d -i \".\\audio.raw\" "
-        "-c:a libmp3lame -q:a 2 "
-        "\".\\audio.mp3\"",
-        SAMPLE_RATE,
-        NUM_CHANNELS
-    );
-
-    BOOL ok = CreateProcess(
-        NULL, cmd,
-        NULL, NULL,
-        FALSE,
-        CREATE_NO_WINDOW,
-        NULL, NULL,
-        &si, &pi
-    );
-
-    if (!ok) {
+        "-f concat -safe 0 -i \"" SEGMENTS_LIST "\" "
+        "-c:v copy "
+        "\"capture.mp4\"");
+    #endif
+
+    HANDLE ffmpegConcat;
+    if(!start_process(cmd, NULL, &ffmpegConcat)) {
         ERROR_EXIT();
     }
+    if(wait_process(ffmpegConcat) != 0) {
+        MessageBox(NULL, "Failed to concatenate the capture segments.", "Error", MB_OK);
+        ExitProcess(1);
+    }
 
-    WaitForSingleObject(pi.hProcess, INFINITE);
+    DeleteFile(SEGMENTS_LIST);
+    for(int i = 0; i < CAPTURE_SEGMENTS; i++) {
+        char path[64];
+        sprintf_s(path, sizeof(path), SEGMENT_FILE, i + 1);
+        DeleteFile(path);
+    }
 
-    DWORD exitCode = 0;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
+    log_printf("Captured %d segments in %.2fs (%.2fs rendering and encoding)\r\n",
+        CAPTURE_SEGMENTS, get_time() - startTime, renderTime);
+}
+#endif
+
+// Canonical WAV header, all fields are naturally aligned
+// http://soundfile.sapp.org/doc/WaveFormat/
+typedef struct {
+    BYTE riffId[4];
+    DWORD riffSize;
+    BYTE waveId[4];
+    BYTE fmtId[4];
+    DWORD fmtSize;
+    WORD audioFormat;
+    WORD numChannels;
+    DWORD sampleRate;
+    DWORD byteRate;
+    WORD blockAlign;
+    WORD bitsPerSample;
+    BYTE dataId[4];
+    DWORD dataSize;
+} WavHeader;
+
+#define WAV_FORMAT_IEEE_FLOAT 3
 
-    CloseHandle(pi.hThread);
-    CloseHandle(pi.hProcess);
+void save_audio(const float* buffer, DWORD nbBytes) {
+    // Save the float samples as is in a WAV file, read directly by the
+    // ffmpeg process encoding the video (see start_capture)
+    WavHeader header = {
+        .riffId = {'R', 'I', 'F', 'F'},
+        .riffSize = sizeof(WavHeader) - 8 + nbBytes,
+        .waveId = {'W', 'A', 'V', 'E'},
+        .fmtId = {'f', 'm', 't', ' '},
+        .fmtSize = 16,
+        .audioFormat = WAV_FORMAT_IEEE_FLOAT,
+        .numChannels = NUM_CHANNELS,
+        .sampleRate = SAMPLE_RATE,
+        .byteRate = BYTE_RATE,
+        .blockAlign = SAMPLE_ALIGNMENT,
+        .bitsPerSample = BIT_DEPTH,
+        .dataId = {'d', 'a', 't', 'a'},
+        .dataSize = nbBytes
+    };
+
+    HANDLE hFile = create_file("audio.wav");
+    if(hFile == INVALID_HANDLE_VALUE) {
+        ERROR_EXIT();
+    }
 
-    if (exitCode != 0) {
-        MessageBox(NULL, "ffmpeg MP3 encoding failed.", "Error", MB_OK);
-        ExitProcess(1);
+    if (!write_file(hFile, &header, sizeof(header), NULL)
+        || !write_file(hFile, buffer, nbBytes, NULL)) {
+        ERROR_EXIT();
     }
 
-    DeleteFile(".\\audio.raw");
-}
\ No newline at end of file
+    CloseHandle(hFile);
+}
+
+#endif
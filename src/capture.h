@@ -1,9 +1,33 @@
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include "platform.h"
+#include "config.h"
 
-void start_capture(void);
+#define CAPTURE_NUM_FRAMES (INTRO_DURATION*CAPTURE_FRAMERATE)
+
+// First frame of a segment of the timeline in segmented captures, see
+// CAPTURE_SEGMENTS. SEGMENT_FIRST_FRAME(CAPTURE_SEGMENTS) is the end.
+#define SEGMENT_FIRST_FRAME(segment) ((segment) * CAPTURE_NUM_FRAMES / CAPTURE_SEGMENTS)
+
+// Time of a sub-frame of accumulated captures, the shutter interval is
+// centered on the frame's time
+#define CAPTURE_SAMPLE_TIME(frame, sample) (float)(((frame) + CAPTURE_SHUTTER * \
+    (((sample) + 0.5) / CAPTURE_SAMPLES - 0.5)) / CAPTURE_FRAMERATE)
+
+// Starts encoding the frames of a segment into its own video, or the
+// whole capture with its audio if segment is negative
+void start_capture(int segment);
 void finish_capture(void);
 void capture_frame(void);
-void save_audio(const float* buffer, DWORD nbBytes);
\ No newline at end of file
+#if CAPTURE_ACCUMULATE
+// Adds the sub-frame just rendered to the captured frame, captured once
+// all its samples are accumulated
+void accumulate_sample(int sample);
+#endif
+void save_audio(const float* buffer, DWORD nbBytes);
+
+#if CAPTURE_SEGMENTS > 1
+// Runs one capture process per segment, all at once, then concatenates
+// their videos
+void capture_segments(void);
+#endif
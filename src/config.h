@@ -9,6 +9,107 @@
 #define YRES 480
 #endif
 
+// Swap interval of the playback: 1 waits for vsync, 0 presents frames
+// immediately and -1 is adaptive vsync (only tears when a frame is late,
+// falls back to 1 if the driver does not support it)
+#ifndef SWAP_INTERVAL
+#define SWAP_INTERVAL 1
+#endif
+
+// Frame rate the playback loop is paced to, 0 to not limit it
+#ifndef TARGET_FRAMERATE
+#define TARGET_FRAMERATE 0
+#endif
+
 #ifndef CAPTURE_FRAMERATE
 #define CAPTURE_FRAMERATE 60
-#endif
\ No newline at end of file
+#endif
+
+// Number of processes rendering and encoding the capture in parallel,
+// each one records a contiguous range of frames
+#ifndef CAPTURE_SEGMENTS
+#define CAPTURE_SEGMENTS 1
+#endif
+
+// Captured frames are converted to YUV 4:2:0 before being piped to ffmpeg:
+// CAPTURE_YUV_GPU by a compute shader before readback, CAPTURE_YUV_CPU after
+// readback, 0 to pipe RGB and let ffmpeg convert them
+#define CAPTURE_YUV_CPU 1
+#define CAPTURE_YUV_GPU 2
+#ifndef CAPTURE_YUV
+#define CAPTURE_YUV CAPTURE_YUV_GPU
+#endif
+
+// Debug builds loading the shaders from files reload them when edited
+#if defined(DEBUG) && !defined(MINIFIED_SHADERS) && !defined(CAPTURE) && !defined(BENCH)
+#define HOT_RELOAD
+#endif
+
+// Size in pixels of the tiles of the cone marching pre-pass: a first pass
+// renders one pixel per tile, the distance up to which the tile's rays are
+// known not to hit anything, where the raymarching of its pixels starts.
+// 0 disables the pre-pass, the default: on this scene, mostly sky, it saves
+// no frame time once its own map() evaluations are counted (see -Heatmap),
+// and tiny builds would pay for its code.
+#ifndef CONE_TILE
+#define CONE_TILE 0
+#endif
+
+// DYNAMIC_RESOLUTION builds render the frames at a fraction of the
+// resolution, adjusted at each frame for the GPU time of the frames to stay
+// around RESOLUTION_BUDGET, and upscale them bilinearly
+#ifndef RESOLUTION_BUDGET
+#if TARGET_FRAMERATE > 0
+#define RESOLUTION_BUDGET (900.f / TARGET_FRAMERATE) // ms, 90% of the frame interval
+#else
+#define RESOLUTION_BUDGET 15.f // ms, 60 Hz displays
+#endif
+#endif
+#define MIN_RESOLUTION_SCALE 0.25f
+#if defined(DYNAMIC_RESOLUTION) && (defined(CAPTURE) || defined(CPU_RENDER))
+#error "Captures and the CPU rendering check are always at full resolution"
+#endif
+
+// Interleaved rendering: each frame only raymarches one pixel out of
+// INTERLEAVE, 2 in a checkerboard or 4 in 2x2 blocks, and the others are
+// reprojected from the previous frame by resolve.frag. 1 renders every
+// pixel, the default: the resolve pass costs more than the raymarching it
+// saves on this scene, mostly sky. On llvmpipe at 640x480, p50 ms/frame is
+// 13.5 fully rendered, 17.7-19.6 with 2 and 14.9-15.3 with 4 (PSNR 43.7 and
+// 40.2 dB). Try it when the scene fills the screen on a GPU, -Bench reports
+// both costs.
+#ifndef INTERLEAVE
+#define INTERLEAVE 1
+#endif
+#if INTERLEAVE > 1 && (defined(DYNAMIC_RESOLUTION) || defined(CPU_RENDER))
+#error "Interleaved frames need a constant resolution and differ from the CPU rendering"
+#endif
+
+// HEATMAP builds replace the image by a false color of the cost of each
+// pixel and log histograms of the raymarching steps by second of the intro
+#if defined(HEATMAP) && defined(CPU_RENDER)
+#error "The CPU rendering cannot be compared to the heatmap"
+#endif
+
+// Offline quality of captures: each frame averages CAPTURE_SAMPLES sub-frames
+// spread over CAPTURE_SHUTTER of the frame interval (motion blur), each one
+// rendered at CAPTURE_SUPERSAMPLING times the resolution and box filtered
+#ifndef CAPTURE_SAMPLES
+#define CAPTURE_SAMPLES 1
+#endif
+#ifndef CAPTURE_SHUTTER
+#define CAPTURE_SHUTTER 0.5 // 180 degrees shutter
+#endif
+#ifndef CAPTURE_SUPERSAMPLING
+#define CAPTURE_SUPERSAMPLING 1
+#endif
+#define CAPTURE_ACCUMULATE (CAPTURE_SAMPLES > 1 || CAPTURE_SUPERSAMPLING > 1)
+
+// Number of frames in flight between rendering, readback and encoding
+// in capture mode. 1 reads back and writes each frame synchronously, on
+// the render thread: the ring only pays off when the GPU and the encoder
+// can run alongside the rendering. On a single core llvmpipe node, 1080p
+// captures ran at 8.3 fps with 1 and 7.0 fps with 3.
+#ifndef CAPTURE_BUFFERS
+#define CAPTURE_BUFFERS 3
+#endif
@@ -0,0 +1,30 @@
+#include "platform.h"
+#include <stdio.h>
+#include "gl_functions.h"
+
+
+GLFunctions gl;
+
+// All the names in a single string, "glCreateShaderProgramv\0glUseProgram\0..."
+// in the order of the table. Modern functions are only exported by name
+// from the driver through wglGetProcAddress, so names cannot be replaced
+// by hashes, but packed together they compress well in tiny builds.
+#define GL_FUNCTION_NAME(type, name) #name "\0"
+static const char glFunctionNames[] = GL_FUNCTIONS(GL_FUNCTION_NAME);
+
+void load_gl_functions(void) {
+    const char* name = glFunctionNames;
+    void** function = (void**)&gl;
+    for(int i = 0; i < (int)(sizeof(gl) / sizeof(void*)); i++) {
+        function[i] = (void*)wglGetProcAddress(name);
+        #ifdef DEBUG
+        if(!function[i]) {
+            char msg[256];
+            sprintf_s(msg, sizeof(msg), "OpenGL function not found: %s", name);
+            MessageBox(NULL, msg, "Error", MB_OK);
+            ExitProcess(1);
+        }
+        #endif
+        while(*name++); // next name
+    }
+}
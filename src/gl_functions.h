@@ -0,0 +1,228 @@
+#pragma once
+
+// Modern OpenGL functions, loaded from the driver once by
+// load_gl_functions() instead of on every call. Only the functions used
+// by the build configuration are listed, each name costs bytes.
+
+#include "platform.h"
+#include <GL/gl.h>
+#include "glext.h" // contains type definitions for all modern OpenGL functions
+#include "config.h"
+
+// The compute shader synthesizer also runs in debug builds with CPU_MUSIC
+// to check the CPU port against it
+#if defined(SOUND) && (!defined(CPU_MUSIC) || defined(DEBUG))
+#define GL_NEEDS_READBACK
+#define GL_NEEDS_COMPUTE
+#endif
+
+// The heatmap histograms are shader storage buffers cleared and read back
+// by intro.c
+#ifdef HEATMAP
+#define GL_HEATMAP_FUNCTIONS(X) \
+    X(PFNGLCLEARNAMEDBUFFERDATAPROC, glClearNamedBufferData)
+#define GL_NEEDS_READBACK
+#define GL_NEEDS_COMPUTE
+#else
+#define GL_HEATMAP_FUNCTIONS(X)
+#endif
+
+#ifdef GL_NEEDS_READBACK
+#define GL_READBACK_FUNCTIONS(X) \
+    X(PFNGLGETNAMEDBUFFERSUBDATAPROC, glGetNamedBufferSubData)
+#else
+#define GL_READBACK_FUNCTIONS(X)
+#endif
+
+#ifdef CAPTURE
+#define GL_CAPTURE_FUNCTIONS(X) \
+    X(PFNGLBINDBUFFERPROC, glBindBuffer) \
+    X(PFNGLUNMAPNAMEDBUFFERPROC, glUnmapNamedBuffer) \
+    X(PFNGLDELETEBUFFERSPROC, glDeleteBuffers)
+#if CAPTURE_YUV == CAPTURE_YUV_GPU
+#define GL_NEEDS_COMPUTE
+#endif
+#else
+#define GL_CAPTURE_FUNCTIONS(X)
+#endif
+
+#if defined(CAPTURE) && CAPTURE_ACCUMULATE
+#define GL_ACCUMULATE_FUNCTIONS(X) \
+    X(PFNGLUNIFORM4FVPROC, glUniform4fv) \
+    X(PFNGLBINDIMAGETEXTUREPROC, glBindImageTexture)
+#define GL_NEEDS_COMPUTE
+#else
+#define GL_ACCUMULATE_FUNCTIONS(X)
+#endif
+
+#ifdef GL_NEEDS_COMPUTE
+#define GL_COMPUTE_FUNCTIONS(X) \
+    X(PFNGLDISPATCHCOMPUTEPROC, glDispatchCompute) \
+    X(PFNGLMEMORYBARRIERPROC, glMemoryBarrier)
+#else
+#define GL_COMPUTE_FUNCTIONS(X)
+#endif
+
+// Persistently mapped parameter blocks of the shaders (params.h), fences
+// are also used by the music synthesis and the capture readback
+#define GL_PARAMS_FUNCTIONS(X) \
+    X(PFNGLMAPNAMEDBUFFERRANGEPROC, glMapNamedBufferRange) \
+    X(PFNGLBINDBUFFERRANGEPROC, glBindBufferRange) \
+    X(PFNGLFENCESYNCPROC, glFenceSync) \
+    X(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync) \
+    X(PFNGLDELETESYNCPROC, glDeleteSync)
+
+// Offscreen rendering, the headless backend has no default framebuffer,
+// and render targets of the cone marching pre-pass, dynamic resolution
+// and interleaved rendering
+#if defined(CAPTURE) || defined(BENCH) || !defined(_WIN32) || CONE_TILE > 0 \
+    || defined(DYNAMIC_RESOLUTION) || INTERLEAVE > 1
+#define GL_FRAMEBUFFER_FUNCTIONS(X) \
+    X(PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers) \
+    X(PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer) \
+    X(PFNGLFRAMEBUFFERTEXTURE2DPROC, glFramebufferTexture2D) \
+    X(PFNGLCHECKFRAMEBUFFERSTATUSPROC, glCheckFramebufferStatus)
+#else
+#define GL_FRAMEBUFFER_FUNCTIONS(X)
+#endif
+
+#ifndef _WIN32
+#define GL_RENDERBUFFER_FUNCTIONS(X) \
+    X(PFNGLGENRENDERBUFFERSPROC, glGenRenderbuffers) \
+    X(PFNGLBINDRENDERBUFFERPROC, glBindRenderbuffer) \
+    X(PFNGLRENDERBUFFERSTORAGEPROC, glRenderbufferStorage) \
+    X(PFNGLFRAMEBUFFERRENDERBUFFERPROC, glFramebufferRenderbuffer)
+#else
+#define GL_RENDERBUFFER_FUNCTIONS(X)
+#endif
+
+#if defined(PROFILE) || defined(DYNAMIC_RESOLUTION)
+#define GL_QUERY_FUNCTIONS(X) \
+    X(PFNGLGENQUERIESPROC, glGenQueries) \
+    X(PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v)
+#else
+#define GL_QUERY_FUNCTIONS(X)
+#endif
+
+#ifdef PROFILE
+#define GL_PROFILE_FUNCTIONS(X) \
+    X(PFNGLDELETEQUERIESPROC, glDeleteQueries) \
+    X(PFNGLBEGINQUERYPROC, glBeginQuery) \
+    X(PFNGLENDQUERYPROC, glEndQuery)
+#else
+#define GL_PROFILE_FUNCTIONS(X)
+#endif
+
+// Frames rendered offscreen and blitted to the playback's target
+#if defined(DYNAMIC_RESOLUTION) || INTERLEAVE > 1
+#define GL_OFFSCREEN_FUNCTIONS(X) \
+    X(PFNGLBLITFRAMEBUFFERPROC, glBlitFramebuffer)
+#else
+#define GL_OFFSCREEN_FUNCTIONS(X)
+#endif
+
+// Timestamps rather than GL_TIME_ELAPSED queries, which cannot be nested
+// in the profiler's
+#ifdef DYNAMIC_RESOLUTION
+#define GL_RESOLUTION_FUNCTIONS(X) \
+    X(PFNGLQUERYCOUNTERPROC, glQueryCounter)
+#else
+#define GL_RESOLUTION_FUNCTIONS(X)
+#endif
+
+#if INTERLEAVE > 1
+#define GL_INTERLEAVE_FUNCTIONS(X) \
+    X(PFNGLACTIVETEXTUREPROC, glActiveTexture)
+#else
+#define GL_INTERLEAVE_FUNCTIONS(X)
+#endif
+
+#ifdef HOT_RELOAD
+#define GL_RELOAD_FUNCTIONS(X) \
+    X(PFNGLDELETEPROGRAMPROC, glDeleteProgram) \
+    X(PFNGLGETSTRINGIPROC, glGetStringi)
+#else
+#define GL_RELOAD_FUNCTIONS(X)
+#endif
+
+// check_shader()
+#ifndef TINY
+#define GL_SHADER_CHECK_FUNCTIONS(X) \
+    X(PFNGLGETPROGRAMIVPROC, glGetProgramiv) \
+    X(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog)
+#else
+#define GL_SHADER_CHECK_FUNCTIONS(X)
+#endif
+
+#define GL_FUNCTIONS(X) \
+    X(PFNGLCREATESHADERPROGRAMVPROC, glCreateShaderProgramv) \
+    X(PFNGLUSEPROGRAMPROC, glUseProgram) \
+    X(PFNGLCREATEBUFFERSPROC, glCreateBuffers) \
+    X(PFNGLNAMEDBUFFERSTORAGEPROC, glNamedBufferStorage) \
+    X(PFNGLBINDBUFFERBASEPROC, glBindBufferBase) \
+    GL_PARAMS_FUNCTIONS(X) \
+    GL_READBACK_FUNCTIONS(X) \
+    GL_HEATMAP_FUNCTIONS(X) \
+    GL_CAPTURE_FUNCTIONS(X) \
+    GL_ACCUMULATE_FUNCTIONS(X) \
+    GL_COMPUTE_FUNCTIONS(X) \
+    GL_FRAMEBUFFER_FUNCTIONS(X) \
+    GL_RENDERBUFFER_FUNCTIONS(X) \
+    GL_QUERY_FUNCTIONS(X) \
+    GL_PROFILE_FUNCTIONS(X) \
+    GL_OFFSCREEN_FUNCTIONS(X) \
+    GL_RESOLUTION_FUNCTIONS(X) \
+    GL_INTERLEAVE_FUNCTIONS(X) \
+    GL_RELOAD_FUNCTIONS(X) \
+    GL_SHADER_CHECK_FUNCTIONS(X)
+
+#define GL_DECLARE_FUNCTION(type, name) type name;
+typedef struct {
+    GL_FUNCTIONS(GL_DECLARE_FUNCTION)
+} GLFunctions;
+
+extern GLFunctions gl;
+
+// Resolves all the functions, call once the GL context is current
+void load_gl_functions(void);
+
+// Calls go through the table: glUseProgram(p) is gl.glUseProgram(p)
+#define glCreateShaderProgramv gl.glCreateShaderProgramv
+#define glUseProgram gl.glUseProgram
+#define glUniform4fv gl.glUniform4fv
+#define glCreateBuffers gl.glCreateBuffers
+#define glNamedBufferStorage gl.glNamedBufferStorage
+#define glBindBufferBase gl.glBindBufferBase
+#define glBindBufferRange gl.glBindBufferRange
+#define glDispatchCompute gl.glDispatchCompute
+#define glMemoryBarrier gl.glMemoryBarrier
+#define glGetNamedBufferSubData gl.glGetNamedBufferSubData
+#define glBindBuffer gl.glBindBuffer
+#define glMapNamedBufferRange gl.glMapNamedBufferRange
+#define glUnmapNamedBuffer gl.glUnmapNamedBuffer
+#define glDeleteBuffers gl.glDeleteBuffers
+#define glBindImageTexture gl.glBindImageTexture
+#define glClearNamedBufferData gl.glClearNamedBufferData
+#define glFenceSync gl.glFenceSync
+#define glClientWaitSync gl.glClientWaitSync
+#define glDeleteSync gl.glDeleteSync
+#define glGenFramebuffers gl.glGenFramebuffers
+#define glBindFramebuffer gl.glBindFramebuffer
+#define glFramebufferTexture2D gl.glFramebufferTexture2D
+#define glCheckFramebufferStatus gl.glCheckFramebufferStatus
+#define glGenRenderbuffers gl.glGenRenderbuffers
+#define glBindRenderbuffer gl.glBindRenderbuffer
+#define glRenderbufferStorage gl.glRenderbufferStorage
+#define glFramebufferRenderbuffer gl.glFramebufferRenderbuffer
+#define glGenQueries gl.glGenQueries
+#define glDeleteQueries gl.glDeleteQueries
+#define glBeginQuery gl.glBeginQuery
+#define glEndQuery gl.glEndQuery
+#define glGetQueryObjectui64v gl.glGetQueryObjectui64v
+#define glQueryCounter gl.glQueryCounter
+#define glBlitFramebuffer gl.glBlitFramebuffer
+#define glActiveTexture gl.glActiveTexture
+#define glDeleteProgram gl.glDeleteProgram
+#define glGetStringi gl.glGetStringi
+#define glGetProgramiv gl.glGetProgramiv
+#define glGetProgramInfoLog gl.glGetProgramInfoLog
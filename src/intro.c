@@ -1,23 +1,445 @@
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include "platform.h"
 #include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <GL/gl.h>
-#include "glext.h" // contains type definitions for all modern OpenGL functions
+#include "gl_functions.h"
 #include "config.h"
 #include "utils.h"
+#include "reload.h"
+#include "params.h"
+#include "intro.h"
 
-// Define the modern OpenGL functions to load from the driver
-
-#define glCreateShaderProgramv ((PFNGLCREATESHADERPROGRAMVPROC)wglGetProcAddress("glCreateShaderProgramv"))
-#define glUseProgram ((PFNGLUSEPROGRAMPROC)wglGetProcAddress("glUseProgram"))
-#define glUniform4fv ((PFNGLUNIFORM4FVPROC)wglGetProcAddress("glUniform4fv"))
 
 #ifdef MINIFIED_SHADERS
 // Generated strings in shaders.c by shader minifier
 extern const char* shader_frag;
+#if INTERLEAVE > 1
+extern const char* resolve_frag;
+#endif
 #endif
 
 static GLuint fragShader;
+static ParamsRing paramsRing;
+
+#ifdef HEATMAP
+// Bins of the histograms of the Heatmap buffer of shader.frag
+#define HEATMAP_STEPS_BINS 33
+#define HEATMAP_MAP_CALLS_BINS 64
+// Statistics are reported by interval of intro time, to find the scenes
+// dominating the frame time
+#define HEATMAP_REPORT_INTERVAL 1.f // seconds
+
+typedef struct {
+    GLuint steps[HEATMAP_STEPS_BINS];
+    GLuint mapCalls[HEATMAP_MAP_CALLS_BINS];
+    GLuint hits, escaped, outOfSteps; // rays by outcome
+    GLuint coneMapCalls; // map() evaluations of the cone pass
+} HeatmapHistograms;
+
+static GLuint heatmapBuffer;
+static int heatmapInterval; // being accumulated
+static int heatmapFrames;
+
+// Compiles the shader with HEATMAP defined, right after its #version line
+static GLuint create_shader(const char* source) {
+    const char* body = strstr(source, "#version");
+    body = body ? strchr(body, '\n') : NULL;
+    body = body ? body + 1 : source;
+    char header[256];
+    sprintf_s(header, sizeof(header), "%.*s#define HEATMAP\n", (int)(body - source), source);
+    const char* sources[2] = {header, body};
+    return glCreateShaderProgramv(GL_FRAGMENT_SHADER, 2, sources);
+}
+
+static void heatmap_init(void) {
+    glCreateBuffers(1, &heatmapBuffer);
+    glNamedBufferStorage(heatmapBuffer, sizeof(HeatmapHistograms), NULL, 0);
+    glClearNamedBufferData(heatmapBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+}
+
+// Smallest bin reaching the percentile p (0-100) of the counts
+static int histogram_percentile(const GLuint* bins, int numBins, double total, float p) {
+    double count = 0.;
+    for(int i = 0; i < numBins; i++) {
+        count += bins[i];
+        if(count >= p / 100.f * total) {
+            return i;
+        }
+    }
+    return numBins - 1;
+}
+
+void heatmap_report(void) {
+    if(heatmapFrames == 0) {
+        return;
+    }
+    HeatmapHistograms histograms;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(heatmapBuffer, 0, sizeof(histograms), &histograms);
+    glClearNamedBufferData(heatmapBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    double pixels = 0., steps = 0., mapCalls = 0.;
+    for(int i = 0; i < HEATMAP_STEPS_BINS; i++) {
+        pixels += histograms.steps[i];
+        steps += i * (double)histograms.steps[i];
+    }
+    for(int i = 0; i < HEATMAP_MAP_CALLS_BINS; i++) {
+        mapCalls += i * (double)histograms.mapCalls[i];
+    }
+    // The tiles cover the frame, each pixel gets 1/CONE_TILE^2 of its tile's
+    double coneMapCalls = histograms.coneMapCalls / pixels;
+    log_printf("Heatmap %4.1f-%4.1f s, %3d frames: %5.2f steps/pixel (p50 %d, p95 %d), "
+        "%5.2f map/pixel (p50 %d, p95 %d, %4.2f of the cone pass), "
+        "%4.1f%% hit, %4.1f%% escaped, %4.1f%% out of steps\n",
+        heatmapInterval * HEATMAP_REPORT_INTERVAL, (heatmapInterval + 1) * HEATMAP_REPORT_INTERVAL,
+        heatmapFrames, steps / pixels,
+        histogram_percentile(histograms.steps, HEATMAP_STEPS_BINS, pixels, 50.f),
+        histogram_percentile(histograms.steps, HEATMAP_STEPS_BINS, pixels, 95.f),
+        mapCalls / pixels + coneMapCalls,
+        histogram_percentile(histograms.mapCalls, HEATMAP_MAP_CALLS_BINS, pixels, 50.f),
+        histogram_percentile(histograms.mapCalls, HEATMAP_MAP_CALLS_BINS, pixels, 95.f),
+        coneMapCalls,
+        histograms.hits / pixels * 100., histograms.escaped / pixels * 100.,
+        histograms.outOfSteps / pixels * 100.);
+    heatmapFrames = 0;
+}
+#else
+#define create_shader(source) glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, (const char**)&(source))
+#endif
+
+#ifdef CAPTURE
+// Supersampled captures render at a multiple of the video resolution
+#define RENDER_SCALE CAPTURE_SUPERSAMPLING
+#else
+#define RENDER_SCALE 1
+#endif
+
+// Paramaters to pass to the fragment shader at each frame as an array of
+// vec4s, the Params uniform block: the resolution, time and cone pass tile
+// size, then the rotations of map() at this frame and the previous one,
+// then the interleaved rendering parameters
+static GLfloat params[4*3] = {(float)(XRES*RENDER_SCALE), (float)(YRES*RENDER_SCALE), 0.f, 0.f};
+
+// Passes of the shader per frame, each with its own copy of the
+// parameters: the cone pass, then the sampling and resolve passes of
+// interleaved rendering
+#define PASSES_PER_FRAME 3
+
+// Uploads the parameters and draws a pass of the shader
+static void draw(void) {
+    params_upload(&paramsRing, params, 4*3);
+    glRects(-1, -1, 1, 1);
+}
+
+#if CONE_TILE > 0 || defined(DYNAMIC_RESOLUTION) || INTERLEAVE > 1
+// Framebuffer rendering to a new texture, the bound one is kept
+static GLuint create_target(GLuint* texture, GLint format, int width, int height, GLint filter) {
+    GLint framebuffer; // the playback's, already bound on Linux
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *texture, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    return fbo;
+}
+#endif
+
+#if defined(DYNAMIC_RESOLUTION) || INTERLEAVE > 1
+// Frames rendered offscreen are blitted to the target intro_do was called
+// with, saved first
+static GLint targetFramebuffers[2]; // draw and read
+static GLint targetViewport[4];
+
+static void save_target(void) {
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffers[0]);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &targetFramebuffers[1]);
+    glGetIntegerv(GL_VIEWPORT, targetViewport);
+}
+
+// Scales the bottom left width x height pixels of fbo to the target,
+// bound again
+static void blit_to_target(GLuint fbo, int width, int height) {
+    GLint* viewport = targetViewport;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffers[0]);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBlitFramebuffer(0, 0, width, height,
+        viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffers[1]);
+}
+#endif
+
+#if CONE_TILE > 0
+// Cone marching pre-pass, see CONE_TILE: the shader renders the start
+// distances of the tiles to a texture that the main pass reads
+#define CONE_XRES ((XRES*RENDER_SCALE + CONE_TILE - 1) / CONE_TILE)
+#define CONE_YRES ((YRES*RENDER_SCALE + CONE_TILE - 1) / CONE_TILE)
+
+static GLuint coneTexture;
+static GLuint coneFbo;
+
+static void cone_init(void) {
+    #ifdef HEATMAP
+    // The tile's map() evaluations in green
+    coneFbo = create_target(&coneTexture, GL_RG32F, CONE_XRES, CONE_YRES, GL_NEAREST);
+    #else
+    coneFbo = create_target(&coneTexture, GL_R32F, CONE_XRES, CONE_YRES, GL_NEAREST);
+    #endif
+}
+
+// Renders the start distances of the tiles of the current resolution, the
+// target of the main pass is restored
+static void cone_pass(void) {
+    GLint framebuffer;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    params[3] = (GLfloat)CONE_TILE;
+    glBindTexture(GL_TEXTURE_2D, 0); // not sampled while rendered to
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, coneFbo);
+    glViewport(0, 0, ((int)params[0] + CONE_TILE - 1) / CONE_TILE, ((int)params[1] + CONE_TILE - 1) / CONE_TILE);
+    draw();
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindTexture(GL_TEXTURE_2D, coneTexture);
+    params[3] = -(GLfloat)CONE_TILE;
+}
+#endif
+
+void intro_rotation(GLfloat time, GLfloat* rotation) {
+    float a = 1.5f*time;
+    rotation[0] = (float)cos(a);
+    rotation[1] = (float)sin(a);
+}
+
+#ifdef DYNAMIC_RESOLUTION
+// Dynamic resolution, see DYNAMIC_RESOLUTION in config.h. Frames are
+// rendered to the bottom left corner of a full resolution texture, then
+// blitted to the target of intro_do. Full scale frames are blitted too, for
+// the measured GPU time to always include the blit (llvmpipe timestamps
+// also only bracket the rendering when the blit flushes it). The GPU time
+// of each frame is measured between two timestamps read back a few frames
+// later not to stall.
+#define RESOLUTION_QUERIES 4
+// Fraction of the way to the scale measured to fit the budget moved by each
+// frame, the measures lag RESOLUTION_QUERIES frames behind
+#define RESOLUTION_DAMPING 0.25f
+
+static GLuint resolutionTexture;
+static GLuint resolutionFbo;
+static GLuint resolutionQueries[2*RESOLUTION_QUERIES]; // start and end
+static float resolutionScales[RESOLUTION_QUERIES]; // of the frames in flight
+static float resolutionScale = 1.f;
+static int resolutionFrame;
+
+#ifndef TINY
+static int resolutionMeasures;
+static double resolutionScaleSum;
+static double resolutionTimeSum;
+static float resolutionMinScale = 1.f;
+
+void resolution_report(void) {
+    if(resolutionMeasures == 0) {
+        return;
+    }
+    log_printf("Dynamic resolution: %d frames, scale avg %.3f min %.3f, GPU time avg %.2f ms "
+        "for a budget of %.2f ms\n",
+        resolutionMeasures, resolutionScaleSum / resolutionMeasures, resolutionMinScale,
+        resolutionTimeSum / resolutionMeasures, RESOLUTION_BUDGET);
+}
+#endif
+
+static void resolution_init(void) {
+    resolutionFbo = create_target(&resolutionTexture, GL_RGBA8, XRES, YRES, GL_LINEAR);
+    glGenQueries(2*RESOLUTION_QUERIES, resolutionQueries);
+}
+
+// Adjusts the scale from the oldest frame in flight, then redirects the
+// frame to the scaled target
+static void resolution_begin(void) {
+    int slot = resolutionFrame % RESOLUTION_QUERIES;
+    if(resolutionFrame >= RESOLUTION_QUERIES) {
+        GLuint64 start, end;
+        glGetQueryObjectui64v(resolutionQueries[2*slot], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(resolutionQueries[2*slot + 1], GL_QUERY_RESULT, &end);
+        float gpuTime = (float)((end - start) * 1e-6);
+        // The GPU time is about proportional to the number of pixels
+        float scale = gpuTime > 0.f ? resolutionScales[slot] * sqrtf(RESOLUTION_BUDGET / gpuTime) : 1.f;
+        scale = scale < MIN_RESOLUTION_SCALE ? MIN_RESOLUTION_SCALE : (scale > 1.f ? 1.f : scale);
+        resolutionScale += RESOLUTION_DAMPING * (scale - resolutionScale);
+
+        #ifndef TINY
+        resolutionMeasures++;
+        resolutionScaleSum += resolutionScales[slot];
+        resolutionTimeSum += gpuTime;
+        resolutionMinScale = resolutionScales[slot] < resolutionMinScale ? resolutionScales[slot] : resolutionMinScale;
+        #endif
+    }
+    resolutionScales[slot] = resolutionScale;
+    glQueryCounter(resolutionQueries[2*slot], GL_TIMESTAMP);
+
+    int width = (int)(XRES * resolutionScale + 0.5f);
+    int height = (int)(YRES * resolutionScale + 0.5f);
+    params[0] = (GLfloat)width;
+    params[1] = (GLfloat)height;
+    save_target();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolutionFbo);
+    glViewport(0, 0, width, height);
+}
+
+// Upscales the frame to the target of intro_do
+static void resolution_end(void) {
+    blit_to_target(resolutionFbo, (int)params[0], (int)params[1]);
+    glQueryCounter(resolutionQueries[2*(resolutionFrame % RESOLUTION_QUERIES) + 1], GL_TIMESTAMP);
+    resolutionFrame++;
+}
+#endif
+
+#if INTERLEAVE > 1
+// Interleaved rendering, see INTERLEAVE in config.h: the shader renders one
+// pixel per block to a compact image, then resolve.frag resolves the frame
+// from it and the previous frame into one of two history targets
+#define BLOCK_HEIGHT (INTERLEAVE / 2) // checkerboard 2x1 blocks or 2x2
+#define HISTORY_XRES (XRES*RENDER_SCALE)
+#define HISTORY_YRES (YRES*RENDER_SCALE)
+#define SAMPLES_XRES ((HISTORY_XRES + 1) / 2)
+#define SAMPLES_YRES ((HISTORY_YRES + BLOCK_HEIGHT - 1) / BLOCK_HEIGHT)
+// Frames further apart than this from the previous one, or before it, are
+// rendered fully
+#define MAX_HISTORY_GAP 0.1f // seconds
+
+// Pixel rendered in the blocks by successive frames, all of them in
+// INTERLEAVE frames
+static const GLfloat blockOffsets[4][2] = {{0.f, 0.f}, {1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f}};
+
+static GLuint resolveShader;
+static GLuint samplesTexture;
+static GLuint samplesFbo;
+static GLuint historyTextures[2];
+static GLuint historyFbos[2];
+static int historyIndex; // target of the next frame
+static GLfloat historyTime = -1e9f;
+static int interleavedFrames;
+static int referenceFrame; // see intro_do_reference
+
+// Texture unit 0 is left active, the cone pass binds its texture there
+static void bind_texture(GLenum unit, GLuint texture) {
+    glActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+static void interleave_init(void) {
+    #ifndef MINIFIED_SHADERS
+    const char* resolve_frag = load_shader("resolve.frag");
+    #endif
+    resolveShader = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, &resolve_frag);
+    #ifndef MINIFIED_SHADERS
+    free((void*)resolve_frag);
+    #endif
+    #ifdef DEBUG
+    if(!check_shader(resolveShader)) {
+        ExitProcess(1);
+    }
+    #endif
+    #ifdef HOT_RELOAD
+    watch_shader("resolve.frag");
+    #endif
+
+    samplesFbo = create_target(&samplesTexture, GL_RGBA16F, SAMPLES_XRES, SAMPLES_YRES, GL_NEAREST);
+    for(int i = 0; i < 2; i++) {
+        historyFbos[i] = create_target(&historyTextures[i], GL_RGBA8, HISTORY_XRES, HISTORY_YRES, GL_LINEAR);
+    }
+}
+
+// Draws the frame interleaved, or fully if the previous one is too far
+static void interleave_draw(GLfloat time) {
+    GLfloat* interleave = params + 8;
+    if(referenceFrame) {
+        interleave[3] = 0.f;
+        draw();
+        return;
+    }
+
+    save_target();
+    if(time < historyTime || time - historyTime > MAX_HISTORY_GAP) {
+        interleave[3] = 0.f;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, historyFbos[historyIndex]);
+        glViewport(0, 0, HISTORY_XRES, HISTORY_YRES);
+        draw();
+    } else {
+        const GLfloat* offset = blockOffsets[interleavedFrames++ % INTERLEAVE];
+        interleave[0] = offset[0];
+        interleave[1] = offset[1];
+        interleave[2] = (GLfloat)BLOCK_HEIGHT;
+        interleave[3] = 1.f;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, samplesFbo);
+        glViewport(0, 0, SAMPLES_XRES, SAMPLES_YRES);
+        draw();
+
+        glUseProgram(resolveShader);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, historyFbos[historyIndex]);
+        glViewport(0, 0, HISTORY_XRES, HISTORY_YRES);
+        bind_texture(GL_TEXTURE1, samplesTexture);
+        bind_texture(GL_TEXTURE2, historyTextures[historyIndex ^ 1]);
+        draw();
+        glUseProgram(fragShader);
+        // Not sampled while rendered to by the next frames
+        bind_texture(GL_TEXTURE1, 0);
+        bind_texture(GL_TEXTURE2, 0);
+    }
+    blit_to_target(historyFbos[historyIndex], HISTORY_XRES, HISTORY_YRES);
+
+    historyIndex ^= 1;
+    historyTime = time;
+    params[6] = params[4];
+    params[7] = params[5];
+}
+
+void intro_do_reference(GLfloat time) {
+    referenceFrame = 1;
+    intro_do(time);
+    referenceFrame = 0;
+}
+#endif
+
+#ifdef HOT_RELOAD
+static BOOL parallelCompile; // GL_KHR_parallel_shader_compile or its ARB twin
+
+// Lets the driver compile the reloaded shaders on its own threads. Not in
+// the table of gl_functions.h, which requires all of its functions.
+static void reload_init(void) {
+    const char* setThreads = NULL;
+    GLint numExtensions;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for(int i = 0; i < numExtensions; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if(strcmp(name, "GL_KHR_parallel_shader_compile") == 0) {
+            setThreads = "glMaxShaderCompilerThreadsKHR";
+        } else if(strcmp(name, "GL_ARB_parallel_shader_compile") == 0 && !setThreads) {
+            setThreads = "glMaxShaderCompilerThreadsARB";
+        }
+    }
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreads = setThreads
+        ? (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)wglGetProcAddress(setThreads) : NULL;
+    if(glMaxShaderCompilerThreads) {
+        glMaxShaderCompilerThreads(0xFFFFFFFF); // as many as the driver wants
+        parallelCompile = TRUE;
+    }
+}
+#endif
 
 void intro_init(void) {
     #ifndef MINIFIED_SHADERS
@@ -28,10 +450,10 @@ void intro_init(void) {
 
     // Create a fragment shader program, the default vertex shader will
     // be used (?)
-    fragShader = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, &shader_frag);
+    fragShader = create_shader(shader_frag);
 
     #ifndef MINIFIED_SHADERS
-    free(shader_frag);
+    free((void*)shader_frag);
     #endif
 
     #ifdef DEBUG
@@ -39,14 +461,117 @@ void intro_init(void) {
         ExitProcess(1);
     }
     #endif
+
+    #ifdef HOT_RELOAD
+    reload_init();
+    watch_shader("shader.frag");
+    #endif
+
+    #ifdef HEATMAP
+    heatmap_init();
+    #endif
+
+    params_init(&paramsRing, 0, 4*3, PASSES_PER_FRAME);
+
+    #if CONE_TILE > 0
+    cone_init();
+    #endif
+    #ifdef DYNAMIC_RESOLUTION
+    resolution_init();
+    #endif
+    #if INTERLEAVE > 1
+    interleave_init();
+    #endif
+}
+
+#ifdef HOT_RELOAD
+static GLuint reloadedShader; // being compiled
+static double reloadStartTime;
+
+// Swaps the program for the edited shader once it compiled, the current one
+// is kept if it fails. With parallel compilation, frames are rendered with
+// the current program in the meantime; without it, checking the status
+// waits for the compilation.
+static void reload_shader(void) {
+    if(!reloadedShader) {
+        char* source = reloaded_shader("shader.frag");
+        if(!source) {
+            return;
+        }
+        reloadStartTime = get_time();
+        reloadedShader = create_shader(source);
+        free(source);
+    }
+
+    GLint completed = GL_TRUE;
+    if(parallelCompile) {
+        glGetProgramiv(reloadedShader, GL_COMPLETION_STATUS_KHR, &completed);
+    }
+    if(!completed) {
+        return;
+    }
+    if(check_shader(reloadedShader)) {
+        glDeleteProgram(fragShader);
+        fragShader = reloadedShader;
+        log_printf("Reloaded shader.frag in %.1f ms\n", (get_time() - reloadStartTime) * 1e3);
+    } else {
+        glDeleteProgram(reloadedShader);
+    }
+    reloadedShader = 0;
 }
 
-// Paramaters to pass to the fragment shader at each frame as an array of vec4s
-static GLfloat params[4*1] = {(float)XRES, (float)YRES, 0.f, 0.f};
+#if INTERLEAVE > 1
+// resolve.frag is small enough to be compiled right away
+static void reload_resolve_shader(void) {
+    char* source = reloaded_shader("resolve.frag");
+    if(!source) {
+        return;
+    }
+    GLuint shader = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, (const char**)&source);
+    free(source);
+    if(check_shader(shader)) {
+        glDeleteProgram(resolveShader);
+        resolveShader = shader;
+        log_printf("Reloaded resolve.frag\n");
+    } else {
+        glDeleteProgram(shader);
+    }
+}
+#endif
+#endif
 
 void intro_do(GLfloat time) {
+    #ifdef HOT_RELOAD
+    reload_shader();
+    #if INTERLEAVE > 1
+    reload_resolve_shader();
+    #endif
+    #endif
+    #ifdef HEATMAP
+    int interval = (int)(time / HEATMAP_REPORT_INTERVAL);
+    if(interval != heatmapInterval) {
+        heatmap_report();
+        heatmapInterval = interval;
+    }
+    heatmapFrames++;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, heatmapBuffer);
+    #endif
+    #ifdef DYNAMIC_RESOLUTION
+    resolution_begin();
+    #endif
     params[2] = time;
+    intro_rotation(time, params + 4);
     glUseProgram(fragShader);
-    glUniform4fv(0, 1, params);
-    glRects(-1, -1, 1, 1);
+    #if CONE_TILE > 0
+    cone_pass();
+    #endif
+    #if INTERLEAVE > 1
+    interleave_draw(time);
+    #else
+    draw();
+    #endif
+    params_end_frame(&paramsRing);
+    #ifdef DYNAMIC_RESOLUTION
+    resolution_end();
+    #endif
 }
\ No newline at end of file
@@ -1,6 +1,33 @@
 #pragma once
 
 #include <GL/gl.h>
+#include "config.h"
 
 void intro_init(void);
-void intro_do(GLfloat time);
\ No newline at end of file
+void intro_do(GLfloat time);
+// Rotation of the scene at time, its cosine and sine
+void intro_rotation(GLfloat time, GLfloat* rotation);
+
+#ifdef HEATMAP
+// Prints the cost statistics accumulated by the heatmap shader since the
+// last report, intro_do reports each interval once it is over. Call at the
+// end of the playback for the last one.
+void heatmap_report(void);
+#endif
+
+#if INTERLEAVE > 1
+// Renders the frame at time fully and straight to the current target, as a
+// reference for the interleaved frames, whose history is left untouched
+void intro_do_reference(GLfloat time);
+#endif
+
+#if defined(DYNAMIC_RESOLUTION) && !defined(TINY)
+// Prints the resolution scales and GPU times of the frames rendered so far
+void resolution_report(void);
+#endif
+
+#ifdef CPU_RENDER
+// Renders the frame at time on the CPU as packed RGB rows, bottom row
+// first like glReadPixels
+void intro_render_cpu(GLubyte* pixels, GLfloat time);
+#endif
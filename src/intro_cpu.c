@@ -0,0 +1,322 @@
+// CPU reference implementation of shaders/shader.frag, selected with the
+// CPU_RENDER build flag, for validating the rendering without a GPU.
+// Rays are marched by packets of VWIDTH horizontal pixels and the frame is
+// split in tiles spread over all cores.
+// The functions below must be kept in sync with the shader.
+#ifdef CPU_RENDER
+
+#include "platform.h"
+#include <math.h>
+#include "config.h"
+#include "utils.h"
+#include "intro.h"
+#include "simd.h"
+
+
+typedef struct {
+    vfloat x, y, z;
+} vvec3;
+
+// Rotations of map(), the same for every pixel of a frame
+typedef struct {
+    float c, s;
+} Rotation;
+
+static vfloat length3(vfloat x, vfloat y, vfloat z) {
+    return vsqrt(vadd(vadd(vmul(x, x), vmul(y, y)), vmul(z, z)));
+}
+
+static vvec3 normalize3(vvec3 v) {
+    vfloat invLength = vdiv(vset(1.f), length3(v.x, v.y, v.z));
+    return (vvec3){vmul(v.x, invLength), vmul(v.y, invLength), vmul(v.z, invLength)};
+}
+
+static vfloat dot3(vvec3 a, vvec3 b) {
+    return vadd(vadd(vmul(a.x, b.x), vmul(a.y, b.y)), vmul(a.z, b.z));
+}
+
+// p.xy *= rot(a), in GLSL a row vector times mat2(c, -s, s, c)
+#define ROTATE(x, y, r) do { \
+    vfloat rx = vsub(vmul(x, vset((r).c)), vmul(y, vset((r).s))); \
+    y = vadd(vmul(x, vset((r).s)), vmul(y, vset((r).c))); \
+    x = rx; \
+} while(0)
+
+static vfloat sd_box(vfloat x, vfloat y, vfloat z, float b) {
+    vfloat qx = vsub(vabs(x), vset(b));
+    vfloat qy = vsub(vabs(y), vset(b));
+    vfloat qz = vsub(vabs(z), vset(b));
+    vfloat zero = vset(0.f);
+    vfloat outside = length3(vmax(qx, zero), vmax(qy, zero), vmax(qz, zero));
+    vfloat inside = vmin(vmax(qx, vmax(qy, qz)), zero);
+    return vadd(outside, inside);
+}
+
+static vfloat map(vvec3 p, Rotation r) {
+    ROTATE(p.x, p.z, r);
+    ROTATE(p.y, p.x, r);
+    ROTATE(p.z, p.y, r);
+    return vsub(sd_box(p.x, p.y, p.z, 0.5f), vset(0.03f));
+}
+
+static vvec3 ray_point(vvec3 ro, vvec3 rd, vfloat t) {
+    return (vvec3){vadd(ro.x, vmul(rd.x, t)), vadd(ro.y, vmul(rd.y, t)), vadd(ro.z, vmul(rd.z, t))};
+}
+
+// Raymarching bounds and over-relaxation, as in the shader
+#define BOUND_RADIUS 0.9f
+#define MAX_DIST 20.f
+#define RELAXATION 1.5f
+
+// Returns -1 in the lanes that miss, rays start at tStart at the earliest
+static vfloat raymarch(vvec3 ro, vvec3 rd, vfloat tStart, Rotation r) {
+    vfloat zero = vset(0.f);
+    // Segment of the ray inside the bounding sphere
+    vfloat b = dot3(ro, rd);
+    vfloat h = vadd(vsub(vmul(b, b), dot3(ro, ro)), vset(BOUND_RADIUS*BOUND_RADIUS));
+    vfloat active = vandnot(vcmplt(h, zero), vasfloat(viset(-1)));
+    h = vsqrt(vmax(h, zero));
+    vfloat t = vmax(vmax(vsub(vsub(zero, b), h), zero), tStart);
+    vfloat tMax = vmin(vadd(vsub(zero, b), h), vset(MAX_DIST));
+
+    vfloat hitT = vset(-1.f);
+    vfloat omega = vset(RELAXATION);
+    vfloat prevD = zero;
+    vfloat stepT = zero;
+    for(int i = 0; i < 32; i++) {
+        active = vand(active, vcmplt(t, tMax));
+        if(!vmovemask(active)) {
+            break; // the whole packet is done
+        }
+        vfloat d = map(ray_point(ro, rd, t), r);
+        // Lanes whose step may have crossed the surface go back to the
+        // largest safe step and continue with plain sphere tracing
+        vfloat fail = vand(vand(active, vcmpgt(omega, vset(1.f))), vcmplt(vadd(d, prevD), stepT));
+        t = vselect(fail, vadd(t, vsub(prevD, stepT)), t);
+        omega = vselect(fail, vset(1.f), omega);
+
+        vfloat hit = vandnot(fail, vand(active, vcmplt(d, vset(0.001f))));
+        hitT = vselect(hit, t, hitT);
+        active = vandnot(hit, active);
+
+        vfloat step = vandnot(fail, active);
+        prevD = vselect(step, d, prevD);
+        stepT = vselect(step, vmul(d, omega), stepT);
+        t = vselect(step, vadd(t, stepT), t);
+    }
+    return hitT;
+}
+
+#if CONE_TILE > 0
+// Start distances of the shader's cone pass, one per tile of CONE_TILE
+// pixels, with room for the packets overlapping the frame's right edge
+#define CONE_XRES ((XRES + CONE_TILE - 1) / CONE_TILE)
+#define CONE_YRES ((YRES + CONE_TILE - 1) / CONE_TILE)
+#define CONE_STRIDE (CONE_XRES + VWIDTH)
+
+static float coneStarts[CONE_STRIDE*CONE_YRES];
+
+// Same as the shader's conemarch()
+static vfloat conemarch(vvec3 ro, vvec3 rd, float k, Rotation r) {
+    vfloat tExit = vset(5.f + BOUND_RADIUS); // length(ro) + BOUND_RADIUS
+    vfloat t = vset(0.f);
+    vfloat active = vasfloat(viset(-1));
+    for(int i = 0; i < 32; i++) {
+        active = vand(active, vcmplt(t, tExit));
+        if(!vmovemask(active)) {
+            break;
+        }
+        vfloat d = map(ray_point(ro, rd, t), r);
+        active = vandnot(vcmplt(vsub(d, vmul(vset(k), t)), vset(0.001f)), active);
+        t = vselect(active, vdiv(vadd(t, d), vset(1.f + k)), t);
+    }
+    return vmin(t, tExit);
+}
+
+// Same as the cone pass of shader.frag's main() for VWIDTH tiles of a row
+static void cone_pass(int x, int y, Rotation r) {
+    vfloat fragX = vadd(vtofloat(viadd(viset(x), VLANES)), vset(0.5f));
+    vfloat u = vsub(vdiv(vmul(fragX, vset((float)CONE_TILE)), vset((float)XRES)), vset(0.5f));
+    u = vmul(u, vset((float)XRES / (float)YRES));
+    vfloat v = vset(((float)y + 0.5f) * (float)CONE_TILE / (float)YRES - 0.5f);
+
+    vvec3 ro = {vset(0.f), vset(0.f), vset(-5.f)};
+    vvec3 rd = normalize3((vvec3){u, v, vset(1.f)});
+    float k = (float)CONE_TILE * 0.7072f / (float)YRES;
+    vstore(coneStarts + y*CONE_STRIDE + x, conemarch(ro, rd, k, r));
+}
+
+// Start distances of VWIDTH pixels of a row
+static vfloat cone_starts(int x, int y) {
+    float tStart[VWIDTH];
+    for(int i = 0; i < VWIDTH; i++) {
+        tStart[i] = coneStarts[y / CONE_TILE * CONE_STRIDE + (x + i) / CONE_TILE];
+    }
+    return vload(tStart);
+}
+#else
+#define cone_starts(x, y) vset(0.f)
+#endif
+
+// Analytic gradient of map(), the same as the shader's mapDual(): the
+// gradient of the box in its frame, rotated back by the inverse rotations
+// in reverse order
+static vvec3 normal(vvec3 p, Rotation r) {
+    ROTATE(p.x, p.z, r);
+    ROTATE(p.y, p.x, r);
+    ROTATE(p.z, p.y, r);
+
+    vfloat zero = vset(0.f);
+    vfloat qx = vsub(vabs(p.x), vset(0.5f));
+    vfloat qy = vsub(vabs(p.y), vset(0.5f));
+    vfloat qz = vsub(vabs(p.z), vset(0.5f));
+    // Outside, the gradient is max(q, 0) with the signs of p (normalized below)
+    vvec3 g = {vmax(qx, zero), vmax(qy, zero), vmax(qz, zero)};
+    // Inside, it is the axis of the largest q
+    vfloat outside = vcmpgt(vmax(qx, vmax(qy, qz)), zero);
+    vfloat alongX = vandnot(outside, vcmpgt(qx, vmax(qy, qz)));
+    vfloat alongY = vandnot(vor(outside, alongX), vcmpgt(qy, qz));
+    vfloat alongZ = vandnot(vor(outside, vor(alongX, alongY)), vasfloat(viset(-1)));
+    vfloat one = vset(1.f);
+    g.x = vor(g.x, vand(alongX, one));
+    g.y = vor(g.y, vand(alongY, one));
+    g.z = vor(g.z, vand(alongZ, one));
+    vfloat signBit = vset(-0.f);
+    g.x = vor(g.x, vand(p.x, signBit));
+    g.y = vor(g.y, vand(p.y, signBit));
+    g.z = vor(g.z, vand(p.z, signBit));
+
+    Rotation inverse = {r.c, -r.s};
+    ROTATE(g.z, g.y, inverse);
+    ROTATE(g.y, g.x, inverse);
+    ROTATE(g.x, g.z, inverse);
+    return normalize3(g);
+}
+
+// Same as shader.frag's main() for VWIDTH pixels of a row, returns the
+// color before gamma correction
+static vvec3 shade(int x, int y, Rotation r) {
+    // Pixel centers, as gl_FragCoord
+    vfloat fragX = vadd(vtofloat(viadd(viset(x), VLANES)), vset(0.5f));
+    vfloat u = vsub(vdiv(fragX, vset((float)XRES)), vset(0.5f));
+    u = vmul(u, vset((float)XRES / (float)YRES));
+    vfloat v = vset(((float)y + 0.5f) / (float)YRES - 0.5f);
+
+    vvec3 ro = {vset(0.f), vset(0.f), vset(-5.f)};
+    vvec3 rd = normalize3((vvec3){u, v, vset(1.f)});
+    vfloat t = raymarch(ro, rd, cone_starts(x, y), r);
+
+    vvec3 sky = {vset(0.5f), vset(0.6f), vset(0.7f)};
+    vfloat hit = vcmpgt(t, vset(0.f));
+    if(!vmovemask(hit)) {
+        return sky;
+    }
+
+    // Basic shading
+    const float l = 0.57735027f; // normalize(vec3(1., 1., -1.))
+    vvec3 ldir = {vset(l), vset(l), vset(-l)};
+    vvec3 p = ray_point(ro, rd, t);
+    vvec3 n = normal(p, r);
+    vvec3 h = normalize3((vvec3){vsub(ldir.x, rd.x), vsub(ldir.y, rd.y), vsub(ldir.z, rd.z)});
+    vfloat zero = vset(0.f);
+    vfloat ndotl = dot3(n, ldir);
+    vfloat fd = vmax(zero, ndotl);
+    vfloat fs = vmax(zero, dot3(n, h));
+    fs = vmul(fs, fs); fs = vmul(fs, fs); fs = vmul(fs, fs); fs = vmul(fs, fs); // pow 16
+    vfloat fr = vsub(vset(1.f), vmax(zero, vsub(zero, dot3(n, rd))));
+    vfloat fr2 = vmul(fr, fr);
+    fr = vmul(vmul(fr2, fr2), fr); // pow 5
+    vfloat spec = vmul(fs, vadd(vset(0.5f), vmul(vset(0.5f), fr)));
+    vfloat ambient = vmul(vset(0.2f), vadd(vmax(zero, vsub(zero, ndotl)), fr));
+
+    vvec3 col = {
+        vadd(vadd(vmul(vset(0.65f), fd), vmul(vset(0.9f), spec)), vmul(vset(0.1f), ambient)),
+        vadd(vadd(vmul(vset(0.6f), fd), vmul(vset(0.8f), spec)), vmul(vset(0.2f), ambient)),
+        vadd(vadd(vmul(vset(0.5f), fd), vmul(vset(0.7f), spec)), vmul(vset(0.3f), ambient))
+    };
+    col.x = vselect(hit, col.x, sky.x);
+    col.y = vselect(hit, col.y, sky.y);
+    col.z = vselect(hit, col.z, sky.z);
+    return col;
+}
+
+// Gamma correction and conversion to an 8 bits UNORM channel
+static GLubyte to_unorm(float c) {
+    c = powf(c, 1.f / 2.2f);
+    c = c < 0.f ? 0.f : (c > 1.f ? 1.f : c);
+    return (GLubyte)(c * 255.f + 0.5f);
+}
+
+// Tile size in pixels, TILE_WIDTH is a multiple of VWIDTH
+#define TILE_WIDTH 32
+#define TILE_HEIGHT 8
+#define TILES_X ((XRES + TILE_WIDTH - 1) / TILE_WIDTH)
+#define TILES_Y ((YRES + TILE_HEIGHT - 1) / TILE_HEIGHT)
+
+typedef struct {
+    GLubyte* pixels;
+    Rotation rotation;
+    volatile LONG nextTile;
+    volatile LONG nextConeRow;
+} RenderJob;
+
+#if CONE_TILE > 0
+// Rows of the cone pass, before the tiles which read them
+static DWORD WINAPI cone_worker(LPVOID arg) {
+    RenderJob* job = (RenderJob*)arg;
+    for(;;) {
+        int y = InterlockedExchangeAdd(&job->nextConeRow, 1);
+        if(y >= CONE_YRES) {
+            return 0;
+        }
+        for(int x = 0; x < CONE_XRES; x += VWIDTH) {
+            cone_pass(x, y, job->rotation);
+        }
+    }
+}
+#endif
+
+static DWORD WINAPI render_worker(LPVOID arg) {
+    RenderJob* job = (RenderJob*)arg;
+    for(;;) {
+        int tile = InterlockedExchangeAdd(&job->nextTile, 1);
+        if(tile >= TILES_X*TILES_Y) {
+            return 0;
+        }
+        int x0 = (tile % TILES_X) * TILE_WIDTH;
+        int y0 = (tile / TILES_X) * TILE_HEIGHT;
+        int x1 = x0 + TILE_WIDTH < XRES ? x0 + TILE_WIDTH : XRES;
+        int y1 = y0 + TILE_HEIGHT < YRES ? y0 + TILE_HEIGHT : YRES;
+
+        for(int y = y0; y < y1; y++) {
+            for(int x = x0; x < x1; x += VWIDTH) {
+                vvec3 col = shade(x, y, job->rotation);
+                float rgb[3][VWIDTH];
+                vstore(rgb[0], col.x);
+                vstore(rgb[1], col.y);
+                vstore(rgb[2], col.z);
+
+                // The last packet of a row may overlap the frame's edge
+                GLubyte* dst = job->pixels + 3*(y*XRES + x);
+                int n = x1 - x < VWIDTH ? x1 - x : VWIDTH;
+                for(int i = 0; i < n; i++) {
+                    dst[3*i] = to_unorm(rgb[0][i]);
+                    dst[3*i + 1] = to_unorm(rgb[1][i]);
+                    dst[3*i + 2] = to_unorm(rgb[2][i]);
+                }
+            }
+        }
+    }
+}
+
+void intro_render_cpu(GLubyte* pixels, GLfloat time) {
+    GLfloat rotation[2];
+    intro_rotation(time, rotation);
+    RenderJob job = {pixels, {rotation[0], rotation[1]}, 0, 0};
+    #if CONE_TILE > 0
+    run_workers(cone_worker, &job);
+    #endif
+    run_workers(render_worker, &job);
+}
+
+#endif
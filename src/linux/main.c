@@ -0,0 +1,183 @@
+// Headless Linux entrypoint, the counterpart of main.c's wWinMain for
+// render nodes without a display or GPU. A surfaceless EGL context is
+// created (e.g. Mesa's llvmpipe software rasterizer) and the intro is
+// rendered into an offscreen framebuffer.
+#include "platform.h"
+#include <stdio.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include "gl_functions.h"
+#include "intro.h"
+#include "music.h"
+#include "config.h"
+#include "capture.h"
+#include "utils.h"
+#include "profile.h"
+#include "bench.h"
+#include "pacing.h"
+
+
+#ifdef SOUND
+static float waveBuffer[MUSIC_BUFFER_SIZE];
+#endif
+
+// The intro needs a compatibility profile (glRects) with GLSL 4.60
+static const EGLint contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 4,
+    EGL_CONTEXT_MINOR_VERSION, 6,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+    EGL_NONE
+};
+
+int main(int argc, char** argv) {
+    // Prefer the surfaceless platform, no X11 or Wayland server is needed
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(eglGetPlatformDisplayEXT) {
+        display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if(display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        fprintf(stderr, "Failed to initialize EGL (0x%x).\n", eglGetError());
+        return 1;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    // No config nor surface: the intro only ever renders into framebuffer objects
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+    if(context == EGL_NO_CONTEXT) {
+        fprintf(stderr,
+            "Failed to create an OpenGL 4.6 compatibility context (0x%x).\n"
+            "If the driver exposes an older version (e.g. llvmpipe 4.5), try setting\n"
+            "MESA_GL_VERSION_OVERRIDE=4.6COMPAT MESA_GLSL_VERSION_OVERRIDE=460.\n",
+            eglGetError());
+        return 1;
+    }
+    if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "Failed to make the EGL context current (0x%x).\n", eglGetError());
+        return 1;
+    }
+
+    load_gl_functions();
+
+    #ifdef DEBUG
+    printf("GL_RENDERER: %s\nGL_VERSION: %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    #endif
+
+    #if defined(BENCH) // Offline benchmark
+        intro_init();
+        run_bench();
+    #elif !defined(CAPTURE) // Headless playback, runs in real time for INTRO_DURATION
+        // There is no default framebuffer without a surface, render
+        // into an offscreen one instead
+        GLuint colorBuffer, fbo;
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, XRES, YRES);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glViewport(0, 0, XRES, YRES);
+
+        intro_init();
+
+        #ifdef SOUND
+        // Nothing to play the music on, but keep the synthesis identical
+        music_start(waveBuffer);
+        #endif
+
+        double startTime = get_time();
+        double elapsedTime = 0.;
+        int numFrames = 0;
+        pacing_init();
+        PROFILE_INIT();
+        while(elapsedTime < INTRO_DURATION) {
+            #ifdef SOUND
+            music_update();
+            #ifdef MUSIC_HOT_RELOAD
+            music_reload((int)(elapsedTime * SAMPLE_RATE));
+            #endif
+            #endif
+            PROFILE_BEGIN_FRAME();
+            intro_do((GLfloat)elapsedTime);
+            PROFILE_END_RENDER();
+            glFinish(); // stands in for SwapBuffers
+            PROFILE_END_FRAME();
+            pacing_frame();
+            numFrames++;
+            elapsedTime = get_time() - startTime;
+        }
+        PROFILE_FINISH();
+        pacing_finish();
+        #ifdef HEATMAP
+        heatmap_report();
+        #endif
+        #ifdef DYNAMIC_RESOLUTION
+        resolution_report();
+        #endif
+
+        printf("Rendered %d frames in %.2fs (%.2f fps)\n",
+            numFrames, elapsedTime, numFrames / elapsedTime);
+    #else // Capture playback
+        int segment = -1; // whole capture
+        #if CAPTURE_SEGMENTS > 1
+        // Segment processes are started with their number as argument, see
+        // capture_segments(). This first one only synthesizes the music.
+        segment = (argc > 1 ? atoi(argv[1]) : 0) - 1;
+        #endif
+
+        #ifdef SOUND
+        if(segment < 0) {
+            music_init(waveBuffer);
+            save_audio(waveBuffer, MUSIC_DATA_BYTES);
+        }
+        #endif
+
+        #ifdef VIDEO
+        #if CAPTURE_SEGMENTS > 1
+        if(segment < 0) {
+            capture_segments();
+            return 0;
+        }
+        int firstFrame = SEGMENT_FIRST_FRAME(segment);
+        int endFrame = SEGMENT_FIRST_FRAME(segment + 1);
+        #else
+        int firstFrame = 0;
+        int endFrame = CAPTURE_NUM_FRAMES;
+        #endif
+
+        intro_init();
+
+        start_capture(segment);
+        for(int i = firstFrame; i < endFrame; i++) {
+            #if CAPTURE_ACCUMULATE
+            for(int j = 0; j < CAPTURE_SAMPLES; j++) {
+                intro_do(CAPTURE_SAMPLE_TIME(i, j));
+                accumulate_sample(j);
+            }
+            #else
+            intro_do((GLfloat)i / (GLfloat)CAPTURE_FRAMERATE);
+            #endif
+            capture_frame();
+
+            if(i % CAPTURE_FRAMERATE == 0) {
+                printf("Recorded frames %d/%d\n", i - firstFrame, endFrame - firstFrame);
+                fflush(stdout);
+            }
+        }
+        #ifdef HEATMAP
+        heatmap_report();
+        #endif
+        finish_capture();
+        #endif
+    #endif
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return 0;
+}
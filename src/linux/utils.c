@@ -0,0 +1,328 @@
+#define _GNU_SOURCE // pipe2
+#include "platform.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <GL/gl.h>
+#include "gl_functions.h"
+#include "utils.h"
+
+// POSIX implementation of utils.h for the headless Linux backend.
+// Errors are reported on stderr instead of message boxes.
+
+
+void error_exit(const char* file, int line) {
+    int err = errno;
+    fprintf(stderr, "At %s:%d:\n%s\n", file, line, strerror(err));
+    exit(err ? err : 1);
+}
+
+const char* base_name(const char* path) {
+    const char* file = path;
+    while (*path != '\0') {
+        if (*path == '\\' || *path == '/') {
+            file = path + 1;
+        }
+        path++;
+    }
+    return file;
+}
+
+BOOL write_file(HANDLE hFile, LPCVOID data, DWORD nbBytes, PDWORD nbWrittenTotal) {
+    const BYTE* p = (const BYTE*)data;
+    if(nbWrittenTotal) {
+        *nbWrittenTotal = 0;
+    }
+    while (nbBytes > 0) {
+        ssize_t nbWritten = write(hFile, p, nbBytes);
+        if (nbWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE; // error
+        }
+        p += nbWritten;
+        nbBytes -= (DWORD)nbWritten;
+        if(nbWrittenTotal) {
+            *nbWrittenTotal += (DWORD)nbWritten;
+        }
+    }
+    return TRUE; // success
+}
+
+BOOL read_file(HANDLE hFile, LPVOID buffer, DWORD nbBytes, PDWORD nbReadTotal) {
+    BYTE* p = (BYTE*)buffer;
+    if(nbReadTotal) {
+        *nbReadTotal = 0;
+    }
+    while (nbBytes > 0) {
+        ssize_t nbRead = read(hFile, p, nbBytes);
+        if (nbRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE; // error
+        }
+        if (nbRead == 0) {
+            break; // unexpected EOF
+        }
+        p += nbRead;
+        nbBytes -= (DWORD)nbRead;
+        if(nbReadTotal) {
+            *nbReadTotal += (DWORD)nbRead;
+        }
+    }
+    return TRUE; // success
+}
+
+char* load_file(const char* path, PDWORD loadedSize) {
+    HANDLE hFile = open(path, O_RDONLY);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(hFile, &st) != 0) {
+        close(hFile);
+        return NULL;
+    }
+
+    DWORD fileSize = (DWORD)st.st_size;
+    char* buffer = (char*)malloc(fileSize + 1); // +1 for null termination
+    if (!buffer) {
+        close(hFile);
+        return NULL;
+    }
+
+    DWORD totalRead;
+    if(!read_file(hFile, buffer, fileSize, &totalRead)) {
+        close(hFile);
+        free(buffer);
+        return NULL;
+    }
+    buffer[totalRead] = '\0';
+
+    close(hFile);
+
+    if (loadedSize != NULL) {
+        *loadedSize = totalRead;
+    }
+
+    return buffer;
+}
+
+HANDLE create_file(const char* path) {
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+BOOL start_process(char* cmd, PHANDLE stdinWrite, PHANDLE process) {
+    int fds[2] = {-1, -1};
+    if(stdinWrite) {
+        // The write end is not inherited across exec
+        if(pipe2(fds, O_CLOEXEC) != 0) {
+            return FALSE;
+        }
+        // A child dying early must surface as a write error, not kill us
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        return FALSE;
+    }
+    if(pid == 0) {
+        if(stdinWrite) {
+            dup2(fds[0], STDIN_FILENO);
+        }
+        execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+        _exit(127);
+    }
+
+    if(stdinWrite) {
+        close(fds[0]);
+        *stdinWrite = fds[1];
+    }
+    *process = pid;
+    return TRUE;
+}
+
+DWORD wait_process(HANDLE process) {
+    int status = 0;
+    while(waitpid(process, &status, 0) < 0) {
+        if(errno != EINTR) {
+            return 1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+BOOL get_executable_path(char* path, DWORD size) {
+    ssize_t length = readlink("/proc/self/exe", path, size - 1);
+    if(length <= 0) {
+        return FALSE;
+    }
+    path[length] = '\0';
+    return TRUE;
+}
+
+typedef struct {
+    LPTHREAD_START_ROUTINE proc;
+    LPVOID arg;
+} ThreadStart;
+
+static void* thread_main(void* start) {
+    ThreadStart ts = *(ThreadStart*)start;
+    free(start);
+    return (void*)(intptr_t)ts.proc(ts.arg);
+}
+
+HANDLE start_thread(LPTHREAD_START_ROUTINE proc, LPVOID arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if(!start) {
+        ERROR_EXIT();
+    }
+    start->proc = proc;
+    start->arg = arg;
+
+    pthread_t thread;
+    errno = pthread_create(&thread, NULL, thread_main, start);
+    if(errno) {
+        ERROR_EXIT();
+    }
+    return (HANDLE)thread;
+}
+
+void join_thread(HANDLE thread) {
+    pthread_join((pthread_t)thread, NULL);
+}
+
+HANDLE create_semaphore(LONG initialCount) {
+    sem_t* semaphore = (sem_t*)malloc(sizeof(sem_t));
+    if(!semaphore || sem_init(semaphore, 0, initialCount) != 0) {
+        ERROR_EXIT();
+    }
+    return (HANDLE)semaphore;
+}
+
+void wait_semaphore(HANDLE semaphore) {
+    while(sem_wait((sem_t*)semaphore) != 0 && errno == EINTR);
+}
+
+void release_semaphore(HANDLE semaphore) {
+    sem_post((sem_t*)semaphore);
+}
+
+void delete_semaphore(HANDLE semaphore) {
+    sem_destroy((sem_t*)semaphore);
+    free((sem_t*)semaphore);
+}
+
+#define MAX_WORKERS 64
+
+void run_workers(LPTHREAD_START_ROUTINE proc, LPVOID arg) {
+    long numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if(numWorkers < 1) {
+        numWorkers = 1;
+    } else if(numWorkers > MAX_WORKERS) {
+        numWorkers = MAX_WORKERS;
+    }
+
+    HANDLE workers[MAX_WORKERS];
+    for(long i = 0; i < numWorkers; i++) {
+        workers[i] = start_thread(proc, arg);
+    }
+    for(long i = 0; i < numWorkers; i++) {
+        join_thread(workers[i]);
+    }
+}
+
+double get_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+void sleep_seconds(double seconds) {
+    struct timespec duration = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (double)(time_t)seconds) * 1e9)
+    };
+    while(nanosleep(&duration, &duration) != 0 && errno == EINTR);
+}
+
+void log_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    fflush(stdout);
+}
+
+char* load_shader(const char* filename) {
+    char path[256];
+    sprintf_s(path, sizeof(path), "src/shaders/%s", filename);
+    char* source = load_file(path, NULL);
+    if(!source) {
+        fprintf(stderr, "Failed to load shader: %s\n", filename);
+        exit(1);
+    }
+    return source;
+}
+
+BOOL check_shader(GLuint shader) {
+    GLint result;
+    glGetProgramiv(shader, GL_LINK_STATUS, &result);
+    if(!result) {
+        GLint infoLength;
+        glGetProgramiv(shader, GL_INFO_LOG_LENGTH, &infoLength);
+        GLchar* info = (GLchar*)malloc(infoLength * sizeof(GLchar));
+        if(!info) {
+            fprintf(stderr, "Check shader malloc failed.\n");
+            exit(1);
+        }
+        glGetProgramInfoLog(shader, infoLength, NULL, info);
+        fprintf(stderr, "Shader error:\n%s\n", info);
+        free(info);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+#ifdef HOT_RELOAD
+void watch_shaders_directory(void (*modified)(const char* filename)) {
+    // Editors either write files in place or replace them with a renamed
+    // temporary file
+    int fd = inotify_init1(IN_CLOEXEC);
+    if(fd < 0 || inotify_add_watch(fd, "src/shaders", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        ERROR_EXIT();
+    }
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for(;;) {
+        ssize_t size = read(fd, events, sizeof(events));
+        if(size < 0 && errno == EINTR) {
+            continue;
+        }
+        if(size <= 0) {
+            ERROR_EXIT();
+        }
+        for(char* next = events; next < events + size; ) {
+            struct inotify_event* event = (struct inotify_event*)next;
+            if(event->len > 0) {
+                modified(event->name);
+            }
+            next += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+// Minimal subset of the Win32 API used by the shared sources (intro.c,
+// music.c, capture.c and utils.h), implemented with POSIX and EGL for the
+// headless Linux backend. Only include this through platform.h.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <EGL/egl.h>
+
+typedef int BOOL;
+typedef int LONG;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef DWORD* PDWORD;
+typedef const void* LPCVOID;
+typedef void* LPVOID;
+
+// File descriptors for files and pipes, process ids for processes,
+// pthread_t for threads
+typedef intptr_t HANDLE;
+typedef HANDLE* PHANDLE;
+#define INVALID_HANDLE_VALUE (-1)
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define WINAPI
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+#define InterlockedExchangeAdd(addend, value) __atomic_fetch_add(addend, value, __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(destination, exchange, comparand) \
+    __sync_val_compare_and_swap(destination, comparand, exchange)
+#define InterlockedExchangePointer(target, value) __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST)
+
+#define ExitProcess(code) exit(code)
+#define CloseHandle(h) close(h)
+#define DeleteFile(path) unlink(path)
+#define sprintf_s snprintf
+
+// There is no one to click on a message box on a render node
+#define MB_OK 0
+#define MessageBox(hwnd, text, caption, type) fprintf(stderr, "%s: %s\n", caption, text)
+
+// EGL resolves core and extension entry points alike
+#define wglGetProcAddress(name) eglGetProcAddress(name)
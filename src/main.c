@@ -3,12 +3,17 @@
 #include <mmeapi.h>
 #include <mmreg.h> // defines WAVE_FORMAT_IEEE_FLOAT
 #include <stdio.h>
+#include <stdlib.h> // _wtoi
 #include <GL/gl.h>
+#include "gl_functions.h"
 #include "intro.h"
 #include "music.h"
 #include "config.h"
 #include "capture.h"
 #include "utils.h"
+#include "profile.h"
+#include "bench.h"
+#include "pacing.h"
 
 
 // https://learn.microsoft.com/en-us/windows/win32/api/wingdi/ns-wingdi-pixelformatdescriptor
@@ -39,17 +44,11 @@ static WAVEFORMATEX waveFormat = {
     .cbSize = 0
 };
 
+// One header per block of the music, queued as soon as the block is
+// synthesized. Setting WHDR_PREPARED directly saves calling waveOutPrepareHeader.
 // https://learn.microsoft.com/en-us/previous-versions/dd743837(v=vs.85)
-static WAVEHDR waveHeader = {
-    .lpData = (LPSTR)waveBuffer,
-    .dwBufferLength = MUSIC_DATA_BYTES,
-    .dwBytesRecorded = 0,
-    .dwUser = 0,
-    .dwFlags = WHDR_PREPARED,
-    .dwLoops = 0,
-    .lpNext = 0,
-    .reserved = 0
-};
+static WAVEHDR waveHeaders[MUSIC_NUM_BLOCKS];
+static int numQueuedBlocks = 0;
 
 // https://learn.microsoft.com/en-us/previous-versions/dd757347(v=vs.85)
 MMTIME musicTime = {
@@ -57,6 +56,60 @@ MMTIME musicTime = {
     .u = {0}
 };
 
+#if defined(DEBUG) && !defined(CAPTURE) && !defined(BENCH)
+#define DEBUG_PLAYER
+
+// Playback controls of debug builds, see WindowProc:
+// - Space: pause
+// - Left/Right: seek 1 second backward/forward, Home: back to the start
+// - Click or drag in the window: seek to the cursor's position on the timeline
+// - Down/Up: halve/double the speed, down to 1/2^MAX_SLOWDOWN (the music is
+//   muted when slowed down)
+// - A/B: loop from/to the current time, L: stop looping
+// - Escape: quit
+#define MAX_SLOWDOWN 4
+#define SEEK_STEP 1. // seconds
+
+typedef struct {
+    BOOL paused;
+    int slowdown; // playing at 1/2^slowdown of the speed
+    double time; // seconds
+    double loopStart;
+    double loopEnd; // no loop unless after loopStart
+    BOOL seeked; // time set by the controls since the last frame
+    double lastUpdateTime;
+    double lastTitleTime;
+} Player;
+
+static Player player;
+
+#ifdef SOUND
+// The audio restarts from the current time after a seek, or stops when it
+// cannot follow the render time. waveOutReset sets its position back to 0.
+static int audioStartSample;
+static BOOL audioPlaying = TRUE;
+#endif
+
+static void player_seek(double time) {
+    player.time = time < 0. ? 0. : (time > INTRO_DURATION ? INTRO_DURATION : time);
+    player.seeked = TRUE;
+}
+
+static void player_key(WPARAM key) {
+    switch(key) {
+        case VK_SPACE: player.paused = !player.paused; break;
+        case VK_LEFT: player_seek(player.time - SEEK_STEP); break;
+        case VK_RIGHT: player_seek(player.time + SEEK_STEP); break;
+        case VK_HOME: player_seek(0.); break;
+        case VK_DOWN: player.slowdown += player.slowdown < MAX_SLOWDOWN; break;
+        case VK_UP: player.slowdown -= player.slowdown > 0; break;
+        case 'A': player.loopStart = player.time; break;
+        case 'B': player.loopEnd = player.time; break;
+        case 'L': player.loopStart = player.loopEnd = 0.; break;
+    }
+}
+#endif
+
 
 #ifdef TINY
     #define EXIT_MAIN(code) ExitProcess(code)
@@ -67,6 +120,99 @@ MMTIME musicTime = {
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+#if defined(SOUND) && !defined(CAPTURE)
+// Queues the music blocks synthesized since the last call
+static void queue_music(void) {
+    int readySamples = music_update();
+    while(numQueuedBlocks < MUSIC_NUM_BLOCKS) {
+        int firstSample = numQueuedBlocks * MUSIC_BLOCK_SAMPLES;
+        int numSamples = min(MUSIC_BLOCK_SAMPLES, NUM_SAMPLES - firstSample);
+        if(firstSample + numSamples > readySamples) {
+            break;
+        }
+
+        #ifdef DEBUG_PLAYER
+        // After a seek, the first block plays from the seek position
+        if(firstSample < audioStartSample) {
+            numSamples -= audioStartSample - firstSample;
+            firstSample = audioStartSample;
+        }
+        #endif
+
+        WAVEHDR* header = &waveHeaders[numQueuedBlocks];
+        header->lpData = (LPSTR)(waveBuffer + NUM_CHANNELS*firstSample);
+        header->dwBufferLength = numSamples * SAMPLE_ALIGNMENT;
+        header->dwFlags = WHDR_PREPARED;
+        if (waveOutWrite(waveHandle, header, sizeof(WAVEHDR)) != MMSYSERR_NOERROR) {
+            #ifdef DEBUG
+            MessageBox(NULL, "Failed to play sound (waveOutWrite).", "Error", MB_OK);
+            #endif
+            ExitProcess(1);
+        }
+        numQueuedBlocks++;
+    }
+}
+#endif
+
+#ifdef DEBUG_PLAYER
+#define TITLE_PERIOD 0.1 // seconds between updates of the window title
+
+// Advances the playback, returns the time to render
+static GLfloat player_update(HWND hwnd) {
+    double now = get_time();
+    double elapsed = now - player.lastUpdateTime;
+    player.lastUpdateTime = now;
+
+    // A seek sets the time, the audio restarts from it below
+    if(!player.seeked) {
+        #ifdef SOUND
+        if(audioPlaying) {
+            // The music is the clock
+            waveOutGetPosition(waveHandle, &musicTime, sizeof(MMTIME));
+            player.time = (double)(audioStartSample + (int)musicTime.u.sample) / SAMPLE_RATE;
+        } else
+        #endif
+        if(!player.paused) {
+            player.time += elapsed / (1 << player.slowdown);
+            player.time = player.time < INTRO_DURATION ? player.time : INTRO_DURATION;
+        }
+    }
+    if(player.loopEnd > player.loopStart && player.time >= player.loopEnd) {
+        player_seek(player.loopStart);
+    }
+
+    #ifdef SOUND
+    BOOL playAudio = !player.paused && player.slowdown == 0 && player.time < INTRO_DURATION;
+    if(player.seeked || playAudio != audioPlaying) {
+        // Requeue the blocks from the current time, see queue_music()
+        waveOutReset(waveHandle);
+        audioPlaying = playAudio;
+        audioStartSample = (int)(player.time * SAMPLE_RATE);
+        numQueuedBlocks = playAudio ? audioStartSample / MUSIC_BLOCK_SAMPLES : MUSIC_NUM_BLOCKS;
+    }
+    queue_music();
+    #endif
+    player.seeked = FALSE;
+
+    if(now - player.lastTitleTime > TITLE_PERIOD) {
+        player.lastTitleTime = now;
+        char title[128];
+        int length = sprintf_s(title, sizeof(title), "%.2f s", player.time);
+        if(player.slowdown > 0) {
+            length += sprintf_s(title + length, sizeof(title) - length, ", 1/%d speed", 1 << player.slowdown);
+        }
+        if(player.paused) {
+            length += sprintf_s(title + length, sizeof(title) - length, ", paused");
+        }
+        if(player.loopEnd > player.loopStart) {
+            sprintf_s(title + length, sizeof(title) - length, ", loop %.2f-%.2f s", player.loopStart, player.loopEnd);
+        }
+        SetWindowText(hwnd, title);
+    }
+    return (GLfloat)player.time;
+}
+#endif
+
 int WINAPI wWinMain(
     HINSTANCE hInstance, // handle to the currently loaded executable
     HINSTANCE hPrevInstance, // legacy from 16-bit Windows, always 0
@@ -109,8 +255,8 @@ int WINAPI wWinMain(
         NULL, NULL, hInstance,
         NULL
     );
-    #elif defined(CAPTURE)
-    // In capture mode, the window is only required for the GL context
+    #elif defined(CAPTURE) || defined(BENCH)
+    // In capture and bench modes, the window is only required for the GL context
     // Frames are rendered in a framebuffer and the window remains hidden
     HWND hwnd = CreateWindow(
         CLASS_NAME,
@@ -160,15 +306,20 @@ int WINAPI wWinMain(
     // Initialize an OpenGL context for this device context
     HGLRC hglrc = wglCreateContext(hdc);
     wglMakeCurrent(hdc, hglrc);
+    load_gl_functions();
 
-    #ifndef CAPTURE // Regular playback
+    #if defined(BENCH) // Offline benchmark
+        intro_init();
+        run_bench();
+    #elif !defined(CAPTURE) // Regular playback
         // Initialize the intro's rendering pipeline
         intro_init();
 
         #ifdef SOUND
-        // Initialize the music file in memory
-        music_init(waveBuffer);
-        // Play the sound file directly from memory, asynchronously for the
+        // Synthesize the first block of music in memory, the rest is
+        // synthesized in the background while the beginning plays
+        music_start(waveBuffer);
+        // Play the sound directly from memory, asynchronously for the
         // music to play in background
         if (waveOutOpen(&waveHandle, WAVE_MAPPER, &waveFormat, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR) {
             #ifdef DEBUG
@@ -176,15 +327,10 @@ int WINAPI wWinMain(
             #endif
             EXIT_MAIN(1);
         }
-        if (waveOutWrite(waveHandle, &waveHeader, sizeof(waveHeader)) != MMSYSERR_NOERROR) {
-            #ifdef DEBUG
-            MessageBox(NULL, "Failed to play sound (waveOutWrite).", "Error", MB_OK);
-            #endif
-            EXIT_MAIN(1);
-        }
+        queue_music();
         // Use music ending as finish condition
-        #define INTRO_NOT_DONE (waveHeader.dwFlags & WHDR_DONE) == 0
-        #else
+        #define INTRO_NOT_DONE (waveHeaders[MUSIC_NUM_BLOCKS-1].dwFlags & WHDR_DONE) == 0
+        #elif !defined(DEBUG_PLAYER) // which keeps its own time
         // Use elapsed time as finish condition
         DWORD startTime = timeGetTime();
         DWORD elapsedTime = 0;
@@ -202,6 +348,11 @@ int WINAPI wWinMain(
         #define CONTINUE_INTRO !GetAsyncKeyState(VK_ESCAPE) && INTRO_NOT_DONE
         #endif
 
+        #ifdef DEBUG_PLAYER
+        player.lastUpdateTime = get_time();
+        #endif
+        pacing_init();
+        PROFILE_INIT();
         while(CONTINUE_INTRO)
         {
             #ifdef DEBUG
@@ -212,7 +363,10 @@ int WINAPI wWinMain(
             #endif
 
             // Pass the elapsed time in seconds since startup to the shaders
-            #ifdef SOUND
+            #ifdef DEBUG_PLAYER
+            GLfloat time = player_update(hwnd);
+            #elif defined(SOUND)
+            queue_music();
             // Get the new music time
             waveOutGetPosition(waveHandle, &musicTime, sizeof(MMTIME));
             GLfloat time = (GLfloat)musicTime.u.sample / SAMPLE_RATE;
@@ -220,39 +374,79 @@ int WINAPI wWinMain(
             elapsedTime = timeGetTime() - startTime;
             GLfloat time = (GLfloat)elapsedTime / 1000.f;
             #endif
+            #if defined(SOUND) && defined(MUSIC_HOT_RELOAD)
+            music_reload((int)(time * SAMPLE_RATE));
+            #endif
 
+            PROFILE_BEGIN_FRAME();
             intro_do(time);
+            PROFILE_END_RENDER();
             SwapBuffers(hdc);
-            
-            Sleep(1); // let other processes some time (1ms)
+            PROFILE_END_FRAME();
+            pacing_frame();
         }
+        PROFILE_FINISH();
+        pacing_finish();
+        #ifdef HEATMAP
+        heatmap_report();
+        #endif
+        #if defined(DYNAMIC_RESOLUTION) && !defined(TINY)
+        resolution_report();
+        #endif
     #else // Capture playback
-        intro_init();
-        
+        int segment = -1; // whole capture
+        #if CAPTURE_SEGMENTS > 1
+        // Segment processes are started with their number as argument, see
+        // capture_segments(). This first one only synthesizes the music.
+        segment = _wtoi(pCmdLine) - 1;
+        #endif
+
         #ifdef SOUND
-        music_init(waveBuffer);
-        save_audio(waveBuffer, MUSIC_DATA_BYTES);
+        if(segment < 0) {
+            music_init(waveBuffer);
+            save_audio(waveBuffer, MUSIC_DATA_BYTES);
+        }
         #endif
 
         #ifdef VIDEO
-        #define NUM_FRAMES INTRO_DURATION*CAPTURE_FRAMERATE
+        #if CAPTURE_SEGMENTS > 1
+        if(segment < 0) {
+            capture_segments();
+            EXIT_MAIN(0);
+        }
+        int firstFrame = SEGMENT_FIRST_FRAME(segment);
+        int endFrame = SEGMENT_FIRST_FRAME(segment + 1);
+        #else
+        int firstFrame = 0;
+        int endFrame = CAPTURE_NUM_FRAMES;
+        #endif
+
+        intro_init();
 
         HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
         char msg[256];
 
-        start_capture();
-        for(int i = 0; i < NUM_FRAMES; i++) {
-            GLfloat time = (GLfloat)i / (GLfloat)CAPTURE_FRAMERATE;
-
-            intro_do(time);
+        start_capture(segment);
+        for(int i = firstFrame; i < endFrame; i++) {
+            #if CAPTURE_ACCUMULATE
+            for(int j = 0; j < CAPTURE_SAMPLES; j++) {
+                intro_do(CAPTURE_SAMPLE_TIME(i, j));
+                accumulate_sample(j);
+            }
+            #else
+            intro_do((GLfloat)i / (GLfloat)CAPTURE_FRAMERATE);
+            #endif
             capture_frame();
 
             if(i % CAPTURE_FRAMERATE == 0) {
                 sprintf_s(msg, sizeof(msg), "Recorded frames %d/%d\r\n",
-                    i, NUM_FRAMES);
+                    i - firstFrame, endFrame - firstFrame);
                 WriteConsole(hConsole, msg, strlen(msg), NULL, NULL);
             }
         }
+        #ifdef HEATMAP
+        heatmap_report();
+        #endif
         finish_capture();
         #endif
     #endif
@@ -275,8 +469,24 @@ LRESULT CALLBACK WindowProc(
     LPARAM lParam
 ) {
     switch(uMsg){
-        case WM_CLOSE:
+        #ifdef DEBUG_PLAYER
+        case WM_LBUTTONDOWN:
+        case WM_MOUSEMOVE:
+            if(wParam & MK_LBUTTON) {
+                RECT rect;
+                GetClientRect(hwnd, &rect);
+                player_seek((double)(short)LOWORD(lParam) / rect.right * INTRO_DURATION);
+            }
+            break;
+        #endif
         case WM_KEYDOWN:
+            #ifdef DEBUG_PLAYER
+            if(wParam != VK_ESCAPE) {
+                player_key(wParam);
+                break;
+            }
+            #endif
+        case WM_CLOSE:
             PBOOL pDone = (PBOOL)GetWindowLongPtr(hwnd, GWLP_USERDATA);
             *pDone = TRUE;
             PostQuitMessage(0);
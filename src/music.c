@@ -1,41 +1,52 @@
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#ifdef SOUND
+
+#include "platform.h"
 #include <malloc.h>
 #include <GL/gl.h>
-#include "glext.h" // contains type definitions for all modern OpenGL functions
+#include "gl_functions.h"
 #include "config.h"
 #include "utils.h"
 #include "music.h"
+#include "params.h"
+#include "reload.h"
 
-// Define the modern OpenGL functions to load from the driver
-
-#define glCreateShaderProgramv ((PFNGLCREATESHADERPROGRAMVPROC)wglGetProcAddress("glCreateShaderProgramv"))
-#define glUseProgram ((PFNGLUSEPROGRAMPROC)wglGetProcAddress("glUseProgram"))
-#define glUniform4fv ((PFNGLUNIFORM4FVPROC)wglGetProcAddress("glUniform4fv"))
-#define glDispatchCompute ((PFNGLDISPATCHCOMPUTEPROC)wglGetProcAddress("glDispatchCompute"))
-#define glCreateBuffers ((PFNGLCREATEBUFFERSPROC)wglGetProcAddress("glCreateBuffers"))
-#define glNamedBufferStorage ((PFNGLNAMEDBUFFERSTORAGEPROC)wglGetProcAddress("glNamedBufferStorage"))
-#define glBindBufferBase ((PFNGLBINDBUFFERBASEPROC)wglGetProcAddress("glBindBufferBase"))
-#define glMemoryBarrier ((PFNGLMEMORYBARRIERPROC)wglGetProcAddress("glMemoryBarrier"))
-#define glGetNamedBufferSubData ((PFNGLGETNAMEDBUFFERSUBDATAPROC)wglGetProcAddress("glGetNamedBufferSubData"))
 
-#define CEIL_DIV(x, y) ((x) + (y) - 1) / (y)
+// Number of samples of the block starting at firstSample, the last one
+// may be shorter
+#define BLOCK_LENGTH(firstSample) \
+    (NUM_SAMPLES - (firstSample) < MUSIC_BLOCK_SAMPLES ? NUM_SAMPLES - (firstSample) : MUSIC_BLOCK_SAMPLES)
 
 #ifdef MINIFIED_SHADERS
 extern const char* music_comp;
 #endif
 
-static GLfloat params[4*1] = {(float)SAMPLE_RATE, 0.f, 0.f, 0.f};
+static float* musicBuffer; // the whole track, filled block by block
+static int readySamples; // number of samples synthesized from the start
 
-void music_init(float* buffer) {
+#ifdef DEBUG
+static double startTime;
+#endif
+
+#if !defined(CPU_MUSIC) || defined(DEBUG)
+static GLuint musicShader;
+static GLuint gpuMusicBuffer;
+// x: sample rate, y: first sample of the block to synthesize, an integer
+// read with floatBitsToUint as floats are not exact past 2^24 samples
+static union {
+    GLfloat f[4*1];
+    GLuint u[4*1];
+} params = {{(float)SAMPLE_RATE, 0.f, 0.f, 0.f}};
+static ParamsRing paramsRing; // one range per block
+
+static void gpu_synth_init(void) {
     #ifndef MINIFIED_SHADERS
     const char* music_comp = load_shader("music.comp");
     #endif
 
-    GLuint musicShader = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, &music_comp);
+    musicShader = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, &music_comp);
 
     #ifndef MINIFIED_SHADERS
-    free(music_comp);
+    free((void*)music_comp);
     #endif
 
     #ifdef DEBUG
@@ -44,18 +55,228 @@ void music_init(float* buffer) {
     }
     #endif
 
-    GLuint gpuMusicBuffer;
     glCreateBuffers(1, &gpuMusicBuffer);
     glNamedBufferStorage(gpuMusicBuffer, MUSIC_DATA_BYTES, NULL, GL_DYNAMIC_STORAGE_BIT);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gpuMusicBuffer);
+    params_init(&paramsRing, 0, 4*1, 1);
+
+    #ifdef MUSIC_HOT_RELOAD
+    watch_shader("music.comp");
+    #endif
+}
 
+static void gpu_synth_block(int firstSample) {
+    params.u[1] = (GLuint)firstSample;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gpuMusicBuffer);
     glUseProgram(musicShader);
-    glUniform4fv(0, 1, params);
+    params_upload(&paramsRing, params.f, 4*1);
     // Dispatch one thread per sample, OpenGL guarantees a least 65535 workgroups
-    glDispatchCompute(CEIL_DIV(NUM_SAMPLES, 1024), 1, 1);
+    glDispatchCompute(MUSIC_BLOCK_SAMPLES / 1024, 1, 1);
     // Wait for shaders writes to be visible by getBufferSubData
     // https://registry.khronos.org/OpenGL-Refpages/gl4/html/glMemoryBarrier.xhtml
     glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+static void gpu_synth_read(float* buffer, int firstSample, int numSamples) {
+    glGetNamedBufferSubData(gpuMusicBuffer,
+        firstSample * SAMPLE_ALIGNMENT, numSamples * SAMPLE_ALIGNMENT,
+        (void*)(buffer + NUM_CHANNELS*firstSample));
+}
+#endif
+
+#if defined(CPU_MUSIC) && defined(DEBUG)
+// Largest accepted difference between the CPU and GPU synthesizers: about
+// 1e-7 on llvmpipe, GPU sin() approximations are within a few 1e-7 of it
+#define CPU_MUSIC_TOLERANCE 1e-5f
+
+// Compares the CPU rendered music against the shader's
+static void music_check_cpu(const float* buffer) {
+    float* gpuBuffer = (float*)malloc(MUSIC_DATA_BYTES);
+    if(!gpuBuffer) {
+        ERROR_EXIT();
+    }
+    double gpuStartTime = get_time();
+    gpu_synth_init();
+    for(int first = 0; first < NUM_SAMPLES; first += MUSIC_BLOCK_SAMPLES) {
+        gpu_synth_block(first);
+    }
+    gpu_synth_read(gpuBuffer, 0, NUM_SAMPLES);
+    double gpuTime = get_time() - gpuStartTime;
+
+    float maxError = 0.f;
+    for(int i = 0; i < MUSIC_BUFFER_SIZE; i++) {
+        float error = buffer[i] - gpuBuffer[i];
+        error = error < 0.f ? -error : error;
+        maxError = error > maxError ? error : maxError;
+    }
+    free(gpuBuffer);
+
+    log_printf("GPU synth: %.1f ms (%.1f Msamples/s), max CPU error: %g\n",
+        gpuTime*1e3, NUM_SAMPLES/gpuTime*1e-6, maxError);
+    if(maxError > CPU_MUSIC_TOLERANCE) {
+        MessageBox(NULL, "CPU music differs from music.comp.", "Error", MB_OK);
+        ExitProcess(1);
+    }
+}
+#endif
+
+// Called once the whole track is synthesized
+static void music_done(void) {
+    #ifdef DEBUG
+    log_printf("Music synthesized in %.1f ms\n", (get_time() - startTime)*1e3);
+    #endif
+    #if defined(CPU_MUSIC) && defined(DEBUG)
+    music_check_cpu(musicBuffer);
+    #endif
+}
+
+#ifdef CPU_MUSIC
+// The rest of the track is synthesized on a background thread, which
+// itself spreads it over all cores and publishes the samples as they
+// are completed
+static HANDLE musicThread;
+static volatile LONG cpuReadySamples;
+
+static DWORD WINAPI music_thread(LPVOID arg) {
+    int first = cpuReadySamples;
+    music_render_cpu(musicBuffer, first, NUM_SAMPLES - first, &cpuReadySamples);
+    return 0;
+}
+
+void music_start(float* buffer) {
+    #ifdef DEBUG
+    startTime = get_time();
+    #endif
+    musicBuffer = buffer;
+    music_render_cpu(buffer, 0, BLOCK_LENGTH(0), &cpuReadySamples);
+    readySamples = cpuReadySamples;
+    #ifdef DEBUG
+    log_printf("First music block ready in %.1f ms\n", (get_time() - startTime)*1e3);
+    #endif
+
+    if(readySamples < NUM_SAMPLES) {
+        musicThread = start_thread(music_thread, NULL);
+    } else {
+        music_done();
+    }
+}
+
+int music_update(void) {
+    if(readySamples < NUM_SAMPLES) {
+        readySamples = InterlockedExchangeAdd(&cpuReadySamples, 0);
+        if(readySamples == NUM_SAMPLES) {
+            join_thread(musicThread);
+            music_done();
+        }
+    }
+    return readySamples;
+}
+#else
+// One block is in flight on the GPU while the previous ones are played,
+// its fence is polled once per frame
+static GLsync blockFence;
+
+static void gpu_synth_next(void) {
+    if(readySamples < NUM_SAMPLES) {
+        gpu_synth_block(readySamples);
+        blockFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else {
+        music_done();
+    }
+}
 
-    glGetNamedBufferSubData(gpuMusicBuffer, 0, MUSIC_DATA_BYTES, (void*)buffer);
-}
\ No newline at end of file
+void music_start(float* buffer) {
+    #ifdef DEBUG
+    startTime = get_time();
+    #endif
+    musicBuffer = buffer;
+    gpu_synth_init();
+
+    // Wait for the first block only
+    gpu_synth_block(0);
+    readySamples = BLOCK_LENGTH(0);
+    gpu_synth_read(buffer, 0, readySamples);
+    #ifdef DEBUG
+    log_printf("First music block ready in %.1f ms\n", (get_time() - startTime)*1e3);
+    #endif
+
+    gpu_synth_next();
+}
+
+int music_update(void) {
+    if(readySamples < NUM_SAMPLES
+        && glClientWaitSync(blockFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) != GL_TIMEOUT_EXPIRED) {
+        glDeleteSync(blockFence);
+        int numSamples = BLOCK_LENGTH(readySamples);
+        gpu_synth_read(musicBuffer, readySamples, numSamples);
+        readySamples += numSamples;
+        gpu_synth_next();
+    }
+    return readySamples;
+}
+#endif
+
+#ifdef MUSIC_HOT_RELOAD
+// Blocks synthesized again after an edit, in playback order from the one
+// being played and wrapping around to the start. The buffer is played
+// from memory, blocks are overwritten in place.
+static int nextResynthBlock;
+static int numResynthBlocks; // left to read back
+static GLsync resynthFence;
+static double resynthStartTime;
+
+static void resynth_next(void) {
+    gpu_synth_block(nextResynthBlock * MUSIC_BLOCK_SAMPLES);
+    resynthFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void music_reload(int playSample) {
+    if(numResynthBlocks > 0) {
+        if(glClientWaitSync(resynthFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        glDeleteSync(resynthFence);
+        int firstSample = nextResynthBlock * MUSIC_BLOCK_SAMPLES;
+        gpu_synth_read(musicBuffer, firstSample, BLOCK_LENGTH(firstSample));
+        if(numResynthBlocks == MUSIC_NUM_BLOCKS) {
+            log_printf("Edited music playing after %.1f ms\n", (get_time() - resynthStartTime)*1e3);
+        }
+        nextResynthBlock = (nextResynthBlock + 1) % MUSIC_NUM_BLOCKS;
+        if(--numResynthBlocks > 0) {
+            resynth_next();
+        } else {
+            log_printf("Music synthesized again in %.1f ms\n", (get_time() - resynthStartTime)*1e3);
+        }
+        return;
+    }
+
+    // Edits made in the meantime wait for the track to be complete
+    if(readySamples < NUM_SAMPLES) {
+        return;
+    }
+    char* source = reloaded_shader("music.comp");
+    if(!source) {
+        return;
+    }
+    resynthStartTime = get_time();
+    GLuint shader = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, (const char**)&source);
+    free(source);
+    if(!check_shader(shader)) {
+        glDeleteProgram(shader); // keep playing the previous version
+        return;
+    }
+    glDeleteProgram(musicShader);
+    musicShader = shader;
+
+    int playBlock = playSample / MUSIC_BLOCK_SAMPLES;
+    nextResynthBlock = playBlock < MUSIC_NUM_BLOCKS ? playBlock : 0;
+    numResynthBlocks = MUSIC_NUM_BLOCKS;
+    resynth_next();
+}
+#endif
+
+void music_init(float* buffer) {
+    music_start(buffer);
+    while(music_update() < NUM_SAMPLES);
+}
+
+#endif
@@ -13,5 +13,33 @@
 #define MUSIC_DATA_BYTES (MUSIC_DURATION * SAMPLE_RATE * NUM_CHANNELS * BIT_DEPTH / 8)
 #define MUSIC_BUFFER_SIZE (NUM_SAMPLES * NUM_CHANNELS)
 
+// The music is synthesized and queued for playback by blocks of samples,
+// a multiple of the compute shader's workgroup size
+#define MUSIC_BLOCK_SAMPLES (16*1024)
+#define MUSIC_NUM_BLOCKS ((NUM_SAMPLES + MUSIC_BLOCK_SAMPLES - 1) / MUSIC_BLOCK_SAMPLES)
 
-void music_init(float* buffer);
\ No newline at end of file
+
+// Synthesizes the first block of the track into buffer, the next ones
+// are synthesized in the background
+void music_start(float* buffer);
+// Continues the synthesis, returns the number of samples ready from the
+// start of the track
+int music_update(void);
+// Synthesizes the whole track, returns once done
+void music_init(float* buffer);
+
+#if defined(HOT_RELOAD) && !defined(CPU_MUSIC)
+#define MUSIC_HOT_RELOAD
+// Picks up edits of music.comp once the track is synthesized: the blocks
+// are synthesized again in the background, from the one containing
+// playSample so that the edit is heard right away. Call once per frame.
+void music_reload(int playSample);
+#endif
+
+#ifdef CPU_MUSIC
+// Renders numSamples stereo samples starting at firstSample on the CPU,
+// buffer holds the whole track. readySamples is set to firstSample, then
+// raised as the samples are completed in order, so that they can be played
+// while the next ones are rendered.
+void music_render_cpu(float* buffer, int firstSample, int numSamples, volatile LONG* readySamples);
+#endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+// CPU implementation of shaders/music.comp, selected with the CPU_MUSIC
+// build flag, for machines without a compute capable GL context.
+// Samples are evaluated VWIDTH at a time with SSE2 (or AVX2 when the
+// compiler targets it) and chunks of samples are spread over all cores.
+// synth() must be kept in sync with the shader when editing the music.
+#ifdef CPU_MUSIC
+
+#include "platform.h"
+#include "config.h"
+#include "utils.h"
+#include "music.h"
+#include "simd.h"
+
+
+#ifdef __AVX2__
+// Interleaves left and right channels into 8 stereo samples
+static void vstore_stereo(float* dst, vfloat l, vfloat r) {
+    vfloat lo = _mm256_unpacklo_ps(l, r); // l0 r0 l1 r1 | l4 r4 l5 r5
+    vfloat hi = _mm256_unpackhi_ps(l, r); // l2 r2 l3 r3 | l6 r6 l7 r7
+    _mm256_storeu_ps(dst, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+#else
+// Interleaves left and right channels into 4 stereo samples
+static void vstore_stereo(float* dst, vfloat l, vfloat r) {
+    _mm_storeu_ps(dst, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(l, r));
+}
+#endif
+
+static const float PI = 3.1415926535f;
+
+// Same as music.comp's main() for VWIDTH consecutive samples
+static void synth(float* dst, int firstSample) {
+    vint gid = viadd(viset(firstSample), VLANES);
+
+    vfloat sampleRate = vset((float)SAMPLE_RATE);
+    vfloat t = vdiv(vtofloat(gid), sampleRate);
+    // x = left, y = right
+    vfloat ax, ay;
+    vsincos(t, &ax, &ay);
+    ax = vadd(vset(0.5f), vmul(vset(0.5f), ax));
+    ay = vadd(vset(0.5f), vmul(vset(0.5f), ay));
+    // Phase of the 440 Hz wave in cycles, from the sample index reduced
+    // like music.comp's. Lanes add at most 440*(VWIDTH-1) < SAMPLE_RATE.
+    vfloat cycles = vadd(vset((float)(firstSample % SAMPLE_RATE * 440 % SAMPLE_RATE)),
+        vmul(vtofloat(VLANES), vset(440.f)));
+    cycles = vselect(vcmplt(cycles, sampleRate), cycles, vsub(cycles, sampleRate));
+    vfloat wave, unused;
+    vsincos(vmul(vset(2.f*PI), vdiv(cycles, sampleRate)), &wave, &unused);
+    vfloat sx = vmul(ax, wave);
+    vfloat sy = vmul(ay, wave);
+
+    sx = vmin(vmax(sx, vset(-1.f)), vset(1.f));
+    sy = vmin(vmax(sy, vset(-1.f)), vset(1.f));
+    vstore_stereo(dst, sx, sy);
+}
+
+// Samples processed by a worker at once, a multiple of VWIDTH small
+// enough for every core to get work on the first block
+#define CHUNK_SAMPLES 1024
+#define NUM_CHUNKS ((NUM_SAMPLES + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES)
+
+typedef struct {
+    float* buffer;
+    int firstSample;
+    int endSample;
+    volatile LONG nextChunk; // sample offset of the next chunk to render
+    volatile LONG* readySamples;
+} SynthJob;
+
+// Set once a chunk is rendered, by chunk of the job
+static volatile LONG chunkDone[NUM_CHUNKS];
+
+// Raises readySamples over the chunks completed in order from it, the
+// worker completing the chunk it stopped at continues
+static void publish_chunks(SynthJob* job) {
+    for(;;) {
+        LONG ready = InterlockedExchangeAdd(job->readySamples, 0);
+        if(ready >= job->endSample
+            || !InterlockedExchangeAdd(&chunkDone[(ready - job->firstSample) / CHUNK_SAMPLES], 0)) {
+            return;
+        }
+        LONG next = ready + CHUNK_SAMPLES < job->endSample ? ready + CHUNK_SAMPLES : job->endSample;
+        InterlockedCompareExchange(job->readySamples, next, ready);
+    }
+}
+
+static DWORD WINAPI synth_worker(LPVOID arg) {
+    SynthJob* job = (SynthJob*)arg;
+    for(;;) {
+        int offset = InterlockedExchangeAdd(&job->nextChunk, CHUNK_SAMPLES);
+        int first = job->firstSample + offset;
+        if(first >= job->endSample) {
+            return 0;
+        }
+        int last = first + CHUNK_SAMPLES;
+        if(last > job->endSample) {
+            last = job->endSample;
+        }
+
+        int i = first;
+        for(; i + VWIDTH <= last; i += VWIDTH) {
+            synth(job->buffer + NUM_CHANNELS*i, i);
+        }
+        if(i < last) { // end of the track
+            float tail[NUM_CHANNELS*VWIDTH];
+            synth(tail, i);
+            for(int k = 0; k < NUM_CHANNELS*(last - i); k++) {
+                job->buffer[NUM_CHANNELS*i + k] = tail[k];
+            }
+        }
+
+        InterlockedExchangeAdd(&chunkDone[offset / CHUNK_SAMPLES], 1);
+        publish_chunks(job);
+    }
+}
+
+void music_render_cpu(float* buffer, int firstSample, int numSamples, volatile LONG* readySamples) {
+    SynthJob job = {buffer, firstSample, firstSample + numSamples, 0, readySamples};
+    for(int i = 0; i < NUM_CHUNKS; i++) {
+        chunkDone[i] = 0;
+    }
+    *readySamples = firstSample;
+    run_workers(synth_worker, &job);
+}
+
+#endif
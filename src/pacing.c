@@ -0,0 +1,89 @@
+#include "platform.h"
+#include <math.h>
+#include "config.h"
+#include "utils.h"
+#include "pacing.h"
+
+
+#ifdef _WIN32
+// From wglext.h (WGL_EXT_swap_control)
+typedef BOOL (WINAPI* PFNWGLSWAPINTERVALEXTPROC)(int interval);
+#endif
+
+#if TARGET_FRAMERATE > 0
+// A frame is waited for by sleeping until this long before it is due, then
+// spinning: sleeps may wake up late by up to about a millisecond
+#define SPIN_TIME 2e-3
+
+static double nextFrameTime;
+#endif
+
+#ifdef DEBUG
+static double lastFrameTime;
+static int numIntervals;
+static double intervalSum;
+static double intervalSquareSum;
+static double minInterval = 1e9;
+static double maxInterval;
+#endif
+
+void pacing_init(void) {
+    #ifdef _WIN32
+    // Adaptive vsync needs WGL_EXT_swap_control_tear, the call fails without it.
+    // There is nothing to swap in the headless Linux backend.
+    PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT =
+        (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
+    if(wglSwapIntervalEXT && !wglSwapIntervalEXT(SWAP_INTERVAL) && SWAP_INTERVAL < 0) {
+        wglSwapIntervalEXT(1);
+    }
+    #endif
+
+    #if TARGET_FRAMERATE > 0
+    nextFrameTime = get_time();
+    #endif
+    #ifdef DEBUG
+    lastFrameTime = get_time();
+    #endif
+}
+
+void pacing_frame(void) {
+    #if TARGET_FRAMERATE > 0
+    nextFrameTime += 1. / TARGET_FRAMERATE;
+    double waitTime = nextFrameTime - get_time();
+    if(waitTime < 0.) {
+        // Late, start the next frame now rather than trying to catch up
+        nextFrameTime -= waitTime;
+    } else {
+        if(waitTime > SPIN_TIME) {
+            sleep_seconds(waitTime - SPIN_TIME);
+        }
+        while(get_time() < nextFrameTime);
+    }
+    #endif
+
+    #ifdef DEBUG
+    double frameTime = get_time();
+    double interval = frameTime - lastFrameTime;
+    lastFrameTime = frameTime;
+    numIntervals++;
+    intervalSum += interval;
+    intervalSquareSum += interval*interval;
+    minInterval = interval < minInterval ? interval : minInterval;
+    maxInterval = interval > maxInterval ? interval : maxInterval;
+    #endif
+}
+
+void pacing_finish(void) {
+    #ifdef DEBUG
+    if(numIntervals == 0) {
+        return;
+    }
+    double average = intervalSum / numIntervals;
+    double variance = intervalSquareSum / numIntervals - average*average;
+    double jitter = sqrt(variance > 0. ? variance : 0.); // standard deviation
+    log_printf("Frame pacing (swap interval %d, target %d fps): %d frames, "
+        "interval avg %.3f ms, jitter %.3f ms, min %.3f ms, max %.3f ms\n",
+        SWAP_INTERVAL, TARGET_FRAMERATE, numIntervals,
+        average*1e3, jitter*1e3, minInterval*1e3, maxInterval*1e3);
+    #endif
+}
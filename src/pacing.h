@@ -0,0 +1,11 @@
+#pragma once
+
+// Frame pacing of the playback loop, see SWAP_INTERVAL and
+// TARGET_FRAMERATE in config.h
+
+// Sets the swap interval, call once the GL context is current
+void pacing_init(void);
+// Call after presenting a frame, waits until the next one is due
+void pacing_frame(void);
+// Reports the measured frame time jitter in debug builds
+void pacing_finish(void);
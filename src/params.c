@@ -0,0 +1,56 @@
+#include "platform.h"
+#include <GL/gl.h>
+#include "gl_functions.h"
+#include "config.h"
+#include "utils.h"
+#include "params.h"
+
+
+// Written without synchronization, coherent mapping makes the stores
+// visible to the commands submitted after them
+#define PARAMS_MAP_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+void params_init(ParamsRing* ring, GLuint binding, int count, int ranges) {
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    ring->stride = (count * (int)sizeof(GLfloat) + alignment - 1) / alignment * alignment;
+    ring->ranges = ranges;
+    ring->binding = binding;
+
+    GLsizeiptr size = (GLsizeiptr)ring->stride * ranges * PARAMS_FRAMES;
+    glCreateBuffers(1, &ring->buffer);
+    glNamedBufferStorage(ring->buffer, size, NULL, PARAMS_MAP_FLAGS);
+    ring->mapped = (GLubyte*)glMapNamedBufferRange(ring->buffer, 0, size, PARAMS_MAP_FLAGS);
+    if(!ring->mapped) {
+        ERROR_EXIT();
+    }
+}
+
+void params_upload(ParamsRing* ring, const GLfloat* params, int count) {
+    if(ring->range == ring->ranges) {
+        params_end_frame(ring);
+    }
+    if(ring->range == 0 && ring->fences[ring->frame]) {
+        glClientWaitSync(ring->fences[ring->frame], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(ring->fences[ring->frame]);
+        ring->fences[ring->frame] = 0;
+    }
+
+    int offset = (ring->frame * ring->ranges + ring->range) * ring->stride;
+    // A plain loop, tiny builds have no C runtime to call memcpy
+    GLfloat* mapped = (GLfloat*)(ring->mapped + offset);
+    for(int i = 0; i < count; i++) {
+        mapped[i] = params[i];
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, ring->binding, ring->buffer, offset, count * sizeof(GLfloat));
+    ring->range++;
+}
+
+void params_end_frame(ParamsRing* ring) {
+    if(ring->range == 0) {
+        return;
+    }
+    ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring->frame = (ring->frame + 1) % PARAMS_FRAMES;
+    ring->range = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Parameters of the shaders, std140 uniform blocks written in a buffer
+// mapped once for the whole run (GL_MAP_PERSISTENT_BIT). The buffer holds
+// PARAMS_FRAMES frames of ranges: while the GPU draws a frame, the next
+// ones are written with plain stores, and a fence per frame only waits when
+// the CPU is that many frames ahead.
+
+#include "gl_functions.h" // GLsync
+
+#define PARAMS_FRAMES 3
+
+typedef struct {
+    GLubyte* mapped;
+    GLuint buffer;
+    GLuint binding; // of the uniform block
+    int stride; // bytes per range, aligned for glBindBufferRange
+    int ranges; // per frame
+    int frame; // being written
+    int range; // next one in the frame
+    GLsync fences[PARAMS_FRAMES];
+} ParamsRing;
+
+// Maps a ring of ranges of count floats, at most ranges draws or
+// dispatches per frame, bound to the uniform block binding point binding
+void params_init(ParamsRing* ring, GLuint binding, int count, int ranges);
+// Copies count floats of params to the next range of the frame and binds
+// it for the next draw or dispatch. The first upload of a frame waits for
+// the GPU to be done with the frame's ranges, uploading more than ranges
+// times ends the frame.
+void params_upload(ParamsRing* ring, const GLfloat* params, int count);
+// Fences the ranges of the frame, call once its draws are submitted
+void params_end_frame(ParamsRing* ring);
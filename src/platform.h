@@ -0,0 +1,11 @@
+#pragma once
+
+// The intro is written against the Win32 API. On Linux (headless
+// render nodes), the few Win32 types and calls used by the shared sources
+// are mapped onto POSIX and EGL, see linux/win32.h.
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include "linux/win32.h"
+#endif
@@ -0,0 +1,190 @@
+#if defined(PROFILE) || defined(BENCH)
+
+#include "platform.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <GL/gl.h>
+#include "gl_functions.h"
+#include "utils.h"
+#include "profile.h"
+
+
+static int compare_floats(const void* a, const void* b) {
+    float fa = *(const float*)a;
+    float fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+float percentile(float* values, int n, float p) {
+    qsort(values, n, sizeof(float), compare_floats);
+    // Nearest rank
+    int rank = (int)(p / 100.f * n + 0.5f);
+    rank = rank < 1 ? 1 : (rank > n ? n : rank);
+    return values[rank - 1];
+}
+
+// Benchmark builds only need percentile()
+#ifdef PROFILE
+
+// GPU timer queries in flight, the result of a frame is read this many
+// frames later to avoid stalling on the GPU
+#define NUM_QUERIES 4
+
+typedef struct {
+    double startTime; // seconds since profile_init
+    float cpuTime; // intro_do, ms
+    float gpuTime; // ms
+    float swapTime; // time spent swapping buffers, ms
+    float frameTime; // interval between the end of two swaps, ms
+} FrameRecord;
+
+static FrameRecord frames[PROFILE_MAX_FRAMES];
+static int numFrames; // total recorded, including overwritten ones
+
+static GLuint queries[NUM_QUERIES];
+static double initTime;
+static double lastSwapTime;
+
+#define FRAME(i) frames[(i) % PROFILE_MAX_FRAMES]
+
+void profile_init(void) {
+    glGenQueries(NUM_QUERIES, queries);
+    initTime = lastSwapTime = get_time();
+}
+
+void profile_begin_frame(void) {
+    FRAME(numFrames).startTime = get_time() - initTime;
+    glBeginQuery(GL_TIME_ELAPSED, queries[numFrames % NUM_QUERIES]);
+}
+
+void profile_end_render(void) {
+    glEndQuery(GL_TIME_ELAPSED);
+    FrameRecord* frame = &FRAME(numFrames);
+    frame->cpuTime = (float)((get_time() - initTime - frame->startTime) * 1e3);
+}
+
+// Waits for the GPU time of a frame if not available yet
+static void read_query(int frame) {
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(queries[frame % NUM_QUERIES], GL_QUERY_RESULT, &elapsed);
+    FRAME(frame).gpuTime = (float)(elapsed * 1e-6);
+}
+
+void profile_end_frame(void) {
+    double now = get_time();
+    FrameRecord* frame = &FRAME(numFrames);
+    frame->swapTime = (float)((now - initTime - frame->startTime) * 1e3) - frame->cpuTime;
+    frame->frameTime = (float)((now - lastSwapTime) * 1e3);
+    lastSwapTime = now;
+
+    // The query object is reused next, read back its oldest result
+    if(numFrames >= NUM_QUERIES - 1) {
+        read_query(numFrames - (NUM_QUERIES - 1));
+    }
+    numFrames++;
+}
+
+// Prints average and percentiles of one of the FrameRecord fields
+static void print_summary(const char* name, size_t offset, int first, int n, float* values) {
+    double sum = 0.;
+    for(int i = 0; i < n; i++) {
+        values[i] = *(float*)((char*)&FRAME(first + i) + offset);
+        sum += values[i];
+    }
+    float p50 = percentile(values, n, 50.f);
+    float p95 = percentile(values, n, 95.f);
+    float p99 = percentile(values, n, 99.f);
+    log_printf("%-6s avg %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+        name, sum / n, p50, p95, p99, values[n - 1]);
+}
+
+// Appends formatted text to a file, through a buffer flushed when full
+static char text[64 * 1024];
+static int textSize;
+
+static void flush_text(HANDLE hFile) {
+    if(!write_file(hFile, text, textSize, NULL)) {
+        ERROR_EXIT();
+    }
+    textSize = 0;
+}
+
+#define WRITE_TEXT(hFile, ...) do { \
+    if(textSize > (int)sizeof(text) - 512) { \
+        flush_text(hFile); \
+    } \
+    textSize += sprintf_s(text + textSize, sizeof(text) - textSize, __VA_ARGS__); \
+} while(0)
+
+static void write_csv(int first, int n) {
+    HANDLE hFile = create_file("profile.csv");
+    if(hFile == INVALID_HANDLE_VALUE) {
+        ERROR_EXIT();
+    }
+    WRITE_TEXT(hFile, "frame,start_ms,cpu_ms,gpu_ms,swap_ms,frame_ms\n");
+    for(int i = first; i < first + n; i++) {
+        FrameRecord* frame = &FRAME(i);
+        WRITE_TEXT(hFile, "%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", i, frame->startTime * 1e3,
+            frame->cpuTime, frame->gpuTime, frame->swapTime, frame->frameTime);
+    }
+    flush_text(hFile);
+    CloseHandle(hFile);
+}
+
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+static void write_trace(int first, int n) {
+    HANDLE hFile = create_file("profile.json");
+    if(hFile == INVALID_HANDLE_VALUE) {
+        ERROR_EXIT();
+    }
+    WRITE_TEXT(hFile, "{\"traceEvents\":[\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for(int i = first; i < first + n; i++) {
+        FrameRecord* frame = &FRAME(i);
+        double start = frame->startTime * 1e6; // microseconds
+        WRITE_TEXT(hFile, ",\n{\"name\":\"intro_do\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+            "\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"frame\":%d}}",
+            start, frame->cpuTime * 1e3, i);
+        WRITE_TEXT(hFile, ",\n{\"name\":\"swap\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+            "\"ts\":%.1f,\"dur\":%.1f}",
+            start + frame->cpuTime * 1e3, frame->swapTime * 1e3);
+        // Only the GPU duration is known, shown from the time it was submitted
+        WRITE_TEXT(hFile, ",\n{\"name\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,"
+            "\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"frame\":%d}}",
+            start, frame->gpuTime * 1e3, i);
+    }
+    WRITE_TEXT(hFile, "\n]}\n");
+    flush_text(hFile);
+    CloseHandle(hFile);
+}
+
+void profile_finish(void) {
+    if(numFrames == 0) {
+        return;
+    }
+    for(int i = numFrames - (NUM_QUERIES - 1); i < numFrames; i++) {
+        if(i >= 0) {
+            read_query(i);
+        }
+    }
+    glDeleteQueries(NUM_QUERIES, queries);
+
+    int n = numFrames < PROFILE_MAX_FRAMES ? numFrames : PROFILE_MAX_FRAMES;
+    int first = numFrames - n;
+
+    static float values[PROFILE_MAX_FRAMES];
+    log_printf("%d frames\n", n);
+    print_summary("cpu", offsetof(FrameRecord, cpuTime), first, n, values);
+    print_summary("gpu", offsetof(FrameRecord, gpuTime), first, n, values);
+    print_summary("swap", offsetof(FrameRecord, swapTime), first, n, values);
+    print_summary("frame", offsetof(FrameRecord, frameTime), first, n, values);
+
+    write_csv(first, n);
+    write_trace(first, n);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+// Frame time instrumentation, enabled with the PROFILE build flag.
+// Per frame CPU time of intro_do, GPU time (GL_TIME_ELAPSED queries) and
+// swap duration and interval are recorded in a preallocated ring buffer,
+// then summarized and written to profile.csv and profile.json (Chrome
+// trace_event format, open in chrome://tracing or ui.perfetto.dev) at exit.
+
+#ifdef PROFILE
+#define PROFILE_INIT() profile_init()
+#define PROFILE_BEGIN_FRAME() profile_begin_frame()
+#define PROFILE_END_RENDER() profile_end_render()
+#define PROFILE_END_FRAME() profile_end_frame()
+#define PROFILE_FINISH() profile_finish()
+#else
+#define PROFILE_INIT()
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_RENDER()
+#define PROFILE_END_FRAME()
+#define PROFILE_FINISH()
+#endif
+
+// Number of frames kept, the oldest ones are overwritten
+#define PROFILE_MAX_FRAMES (1 << 16)
+
+void profile_init(void);
+// Call before intro_do
+void profile_begin_frame(void);
+// Call after intro_do, before swapping buffers
+void profile_end_render(void);
+// Call after swapping buffers
+void profile_end_frame(void);
+// Writes the recorded frames and prints a summary
+void profile_finish(void);
+
+// Value at percentile p (0-100) of n values, values are sorted in place
+float percentile(float* values, int n, float p);
@@ -0,0 +1,73 @@
+#include "platform.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "utils.h"
+#include "reload.h"
+
+#ifdef HOT_RELOAD
+
+#define MAX_WATCHED_SHADERS 8
+// A modified file may still be open by the editor, loading it is retried
+#define LOAD_ATTEMPTS 10
+#define LOAD_RETRY_DELAY 0.02 // seconds
+
+typedef struct {
+    const char* filename;
+    char* volatile source; // loaded but not compiled yet
+} WatchedShader;
+
+static WatchedShader watchedShaders[MAX_WATCHED_SHADERS];
+static volatile int numWatchedShaders;
+static HANDLE watchThread;
+
+static void shader_modified(const char* filename) {
+    for(int i = 0; i < numWatchedShaders; i++) {
+        if(strcmp(filename, watchedShaders[i].filename) != 0) {
+            continue;
+        }
+
+        char path[256];
+        sprintf_s(path, sizeof(path), "src/shaders/%s", filename);
+        char* source = load_file(path, NULL);
+        for(int attempt = 1; !source && attempt < LOAD_ATTEMPTS; attempt++) {
+            sleep_seconds(LOAD_RETRY_DELAY);
+            source = load_file(path, NULL);
+        }
+        if(!source) {
+            log_printf("Failed to reload shader: %s\n", filename);
+            return;
+        }
+        // Supersedes a source the render loop has not picked up yet
+        free(InterlockedExchangePointer((void* volatile*)&watchedShaders[i].source, source));
+    }
+}
+
+static DWORD WINAPI watch_thread(LPVOID arg) {
+    watch_shaders_directory(shader_modified);
+    return 0;
+}
+
+void watch_shader(const char* filename) {
+    if(numWatchedShaders == MAX_WATCHED_SHADERS) {
+        return;
+    }
+    watchedShaders[numWatchedShaders].filename = filename;
+    numWatchedShaders++;
+    if(!watchThread) {
+        // Runs until the process exits
+        watchThread = start_thread(watch_thread, NULL);
+    }
+}
+
+char* reloaded_shader(const char* filename) {
+    for(int i = 0; i < numWatchedShaders; i++) {
+        if(strcmp(filename, watchedShaders[i].filename) == 0) {
+            return (char*)InterlockedExchangePointer((void* volatile*)&watchedShaders[i].source, NULL);
+        }
+    }
+    return NULL;
+}
+
+#endif
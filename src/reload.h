@@ -0,0 +1,16 @@
+#pragma once
+
+#include "platform.h"
+#include "config.h"
+
+// Hot reload of the shaders in debug builds, see HOT_RELOAD. A background
+// thread watches src/shaders and loads the new source of a watched shader
+// as soon as its file is modified, the render loop only compiles it.
+
+#ifdef HOT_RELOAD
+// Starts watching a file of src/shaders
+void watch_shader(const char* filename);
+// New source of a watched shader if its file was modified since the last
+// call, NULL otherwise. To be freed by the caller.
+char* reloaded_shader(const char* filename);
+#endif
@@ -0,0 +1,92 @@
+// Resolve pass of the interleaved rendering, see INTERLEAVE in config.h.
+// A program of its own: drivers running both sides of the branches (like
+// llvmpipe) would otherwise pay for the whole of shader.frag per pixel.
+
+#version 460
+
+// Same block as shader.frag
+layout (std140, binding=0) uniform Params {
+    vec4 params; // x,y: resolution
+    vec2 rotation; // cos and sin of the scene's angle
+    vec2 prevRotation; // of the previous frame
+    vec4 interleave; // xy: offset of the rendered pixels, z: block height
+};
+
+// Pixels of the compact image rendered by shader.frag, with their
+// distance (or -1) in alpha, and the previous frame
+layout (binding=1) uniform sampler2D samples;
+layout (binding=2) uniform sampler2D history;
+
+out vec4 outCol;
+
+// Pixel of the compact image holding the rendered pixel p of the frame,
+// shifts rather than divisions by the uniform block height (1 or 2)
+vec4 fresh(ivec2 p) {
+    ivec2 c = ivec2(p.x >> 1, p.y >> (int(interleave.z) - 1));
+    return texelFetch(samples, clamp(c, ivec2(0), textureSize(samples, 0) - 1), 0);
+}
+
+// Position at the previous frame of the point p of the scene, undoing the
+// rotations of map() at this frame and applying the previous ones
+vec3 reproject(vec3 p) {
+    mat2 r = mat2(rotation.x, -rotation.y, rotation.y, rotation.x);
+    mat2 rp = mat2(prevRotation.x, -prevRotation.y, prevRotation.y, prevRotation.x);
+    p.xz *= r;
+    p.yx *= r;
+    p.zy *= r;
+    p.zy = rp*p.zy;
+    p.yx = rp*p.yx;
+    p.xz = rp*p.xz;
+    return p;
+}
+
+// Pixels rendered this frame are copied, the others are taken from the
+// previous frame at the position of their surface, clamped to the colors
+// of the rendered neighbors not to ghost
+void main()
+{
+    vec3 ro = vec3(0.,0.,-5.);
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 o = ivec2(interleave.xy);
+    int h = int(interleave.z);
+    outCol = vec4(1.);
+    // Nearest rendered pixels: the 4 neighbors of a checkerboard, the
+    // corners of the block around p otherwise. Pixels rendered this frame
+    // are their own 4 neighbors, then lo == hi is their color: a single
+    // path, drivers running both sides of the branches would fetch them
+    // twice.
+    ivec2 p0 = h == 1 ? p : ((p - o) & ~1) + o;
+    ivec2 d0 = h == 1 ? ivec2(1, 0) : ivec2(0);
+    ivec2 d1 = h == 1 ? ivec2(0, 1) : ivec2(2, 0);
+    ivec2 d2 = h == 1 ? ivec2(-1, 0) : ivec2(0, 2);
+    ivec2 d3 = h == 1 ? ivec2(0, -1) : ivec2(2, 2);
+    if(h == 1 ? ((p.x + p.y + o.x) & 1) == 0 : all(equal(p & 1, o))){
+        p0 = p;
+        d0 = d1 = d2 = d3 = ivec2(0);
+    }
+    vec4 n0 = fresh(p0 + d0);
+    vec4 n1 = fresh(p0 + d1);
+    vec4 n2 = fresh(p0 + d2);
+    vec4 n3 = fresh(p0 + d3);
+    vec3 lo = min(min(n0.rgb, n1.rgb), min(n2.rgb, n3.rgb));
+    vec3 hi = max(max(n0.rgb, n1.rgb), max(n2.rgb, n3.rgb));
+
+    // Distance of the surface: the nearest hit of the neighbors
+    float t = 1e9;
+    t = n0.a > 0. ? min(t, n0.a) : t;
+    t = n1.a > 0. ? min(t, n1.a) : t;
+    t = n2.a > 0. ? min(t, n2.a) : t;
+    t = n3.a > 0. ? min(t, n3.a) : t;
+    if(t == 1e9 || lo == hi){
+        // All missed, the sky, or rendered this frame: the history would
+        // be clamped to lo anyway
+        outCol.rgb = lo;
+        return;
+    }
+    vec2 c = (vec2(p) + 0.5)/params.xy - 0.5;
+    c.x *= params.x/params.y;
+    vec3 v = reproject(ro + normalize(vec3(c, 1.))*t) - ro;
+    vec2 uv = v.xy/v.z;
+    uv.x *= params.y/params.x;
+    outCol.rgb = clamp(texture(history, uv + 0.5).rgb, lo, hi);
+}
@@ -2,16 +2,54 @@
 
 #version 460
 
-layout (location=0) uniform vec4 params;
+// Updated by intro_do at each frame
+layout (std140, binding=0) uniform Params {
+    vec4 params; // x,y: resolution, z: time, w: cone pass tile size, negated in the main pass
+    vec2 rotation; // cos and sin of the scene's angle, computed on the CPU
+    vec2 prevRotation; // of the previous frame, for the reprojection
+    // Interleaved rendering, see INTERLEAVE in config.h. xy: offset of the
+    // pixels rendered this frame in their 2x2 (z = 2) or 2x1 (z = 1, rows
+    // alternating, a checkerboard) block, w: 0 renders every pixel, 1 one
+    // pixel per block to a compact image, resolved by resolve.frag
+    vec4 interleave;
+};
 
+// Start distances of the tiles, written by the cone pass
+layout (binding=0) uniform sampler2D coneStarts;
 out vec4 outCol;
 
+// Normal evaluation: 0 central differences (6 map() calls), 1 tetrahedron
+// technique (4 map() calls), 2 analytic gradient of map() computed by forward
+// mode differentiation (1 evaluation, exact)
+#define NORMALS 2
 
-mat2 rot(float a) {
-    float c = cos(a);
-    float s = sin(a);
-    return mat2(c, -s, s, c);
+// Raymarching: rays are only marched inside the bounding sphere of the
+// scene and up to MAX_DIST, with steps over-relaxed by RELAXATION (1 for
+// plain sphere tracing)
+#define BOUND_RADIUS 0.9 // rotating cube: sqrt(3)*0.5 + 0.03
+#define MAX_DIST 20.
+#define RELAXATION 1.5
+
+#ifdef HEATMAP
+// Cost visualization, see the HEATMAP build flag. Per pixel histograms of
+// the raymarching steps and of the map() evaluations, and number of rays
+// by outcome, read back by intro.c.
+layout(std430, binding=1) buffer Heatmap {
+    uint stepsHistogram[33];
+    uint mapCallsHistogram[64];
+    uint outcomes[3]; // hit, escaped the bounds, ran out of steps
+    uint coneMapCalls; // of all the tiles of the cone pass
+};
+int mapCalls = 0;
+int steps = 0;
+bool outOfSteps = false;
+
+// Blue to red false color of x in [0,1]
+vec3 heat(float x) {
+    return clamp(1.5 - abs(4.*x - vec3(3.,2.,1.)), 0., 1.);
 }
+#endif
+
 
 // box SDF from: https://iquilezles.org/articles/distfunctions/
 float sdBox(vec3 p, vec3 b){
@@ -20,26 +58,138 @@ float sdBox(vec3 p, vec3 b){
 }
 
 float map(vec3 p){
-    float a = 1.5*params.z;
-    p.xz *= rot(a);
-    p.yx *= rot(a);
-    p.zy *= rot(a);
+    #ifdef HEATMAP
+    mapCalls++;
+    #endif
+    mat2 r = mat2(rotation.x, -rotation.y, rotation.y, rotation.x);
+    p.xz *= r;
+    p.yx *= r;
+    p.zy *= r;
     float db = sdBox(p, vec3(0.5)) - 0.03;
     return db;
 }
 
-float raymarch(vec3 ro, vec3 rd) {
-    float t = 0.;
-    for(int i = 0; i < 32; i++){
+// Over-relaxed sphere tracing: https://doi.org/10.1111/cgf.12274
+// Starts at tStart if the ray is known to be empty before
+float raymarch(vec3 ro, vec3 rd, float tStart) {
+    // Segment of the ray inside the bounding sphere
+    float b = dot(ro, rd);
+    float h = b*b - dot(ro, ro) + BOUND_RADIUS*BOUND_RADIUS;
+    if(h < 0.){
+        return -1.;
+    }
+    h = sqrt(h);
+    float t = max(max(-b - h, 0.), tStart);
+    float tMax = min(-b + h, MAX_DIST);
+
+    float omega = RELAXATION;
+    float prevD = 0.;
+    float stepT = 0.;
+    for(int i = 0; i < 32 && t < tMax; i++){
+        #ifdef HEATMAP
+        steps = i + 1;
+        #endif
         float d = map(ro + rd*t);
+        if(omega > 1. && d + prevD < stepT){
+            // The unbounding spheres of the last two points do not overlap,
+            // the step may have crossed the surface: back to the largest
+            // safe step, then plain sphere tracing
+            t += prevD - stepT;
+            omega = 1.;
+            continue;
+        }
         if(d < 0.001){
             return t;
         }
-        t += d;
+        prevD = d;
+        stepT = d*omega;
+        t += stepT;
     }
+    #ifdef HEATMAP
+    outOfSteps = t < tMax;
+    #endif
     return -1.;
 }
 
+// Cone marching: distance up to which the cone of apex ro, axis rd and
+// radius k*t at distance t is empty. Spheres of radius d around points of
+// the axis are empty, the cone is inside them up to (t + d)/(1 + k).
+float conemarch(vec3 ro, vec3 rd, float k) {
+    // Beyond, the whole cone is past the bounding sphere
+    float tExit = length(ro) + BOUND_RADIUS;
+    float t = 0.;
+    for(int i = 0; i < 32 && t < tExit; i++){
+        float d = map(ro + rd*t);
+        if(d - k*t < 0.001){
+            break; // the cone may touch the surface
+        }
+        t = (t + d)/(1. + k);
+    }
+    return min(t, tExit);
+}
+
+#if NORMALS == 2
+// Forward mode differentiation with dual numbers: x holds a value and yzw
+// its gradient with respect to the point p of map()
+
+// p.xy *= mat2(c, -s, s, c), linear so values and gradients rotate alike
+void rotDual(inout vec4 x, inout vec4 y, float c, float s) {
+    vec4 rx = x*c - y*s;
+    y = x*s + y*c;
+    x = rx;
+}
+
+vec4 maxDual(vec4 a, vec4 b) {
+    return a.x > b.x ? a : b;
+}
+
+vec4 sdBoxDual(vec4 x, vec4 y, vec4 z, vec3 b) {
+    // abs() flips the gradient of negative values
+    vec4 qx = x*sign(x.x) - vec4(b.x, 0., 0., 0.);
+    vec4 qy = y*sign(y.x) - vec4(b.y, 0., 0., 0.);
+    vec4 qz = z*sign(z.x) - vec4(b.z, 0., 0., 0.);
+    vec4 zero = vec4(0.);
+    vec4 mx = maxDual(qx, zero);
+    vec4 my = maxDual(qy, zero);
+    vec4 mz = maxDual(qz, zero);
+    float l = length(vec3(mx.x, my.x, mz.x));
+    vec4 outside = l > 0. ? vec4(l, (mx.x*mx.yzw + my.x*my.yzw + mz.x*mz.yzw)/l) : zero;
+    vec4 inside = maxDual(qx, maxDual(qy, qz));
+    return outside + (inside.x < 0. ? inside : zero);
+}
+
+// map() and its gradient
+vec4 mapDual(vec3 p){
+    #ifdef HEATMAP
+    mapCalls++;
+    #endif
+    vec4 x = vec4(p.x, 1., 0., 0.);
+    vec4 y = vec4(p.y, 0., 1., 0.);
+    vec4 z = vec4(p.z, 0., 0., 1.);
+    float c = rotation.x;
+    float s = rotation.y;
+    rotDual(x, z, c, s);
+    rotDual(y, x, c, s);
+    rotDual(z, y, c, s);
+    return sdBoxDual(x, y, z, vec3(0.5)) - vec4(0.03, 0., 0., 0.);
+}
+
+vec3 normal(vec3 p){
+    return normalize(mapDual(p).yzw);
+}
+#elif NORMALS == 1
+// tetrahedron technique: https://iquilezles.org/articles/normalsSDF/
+vec3 normal(vec3 p){
+    vec2 k = vec2(1., -1.);
+    float h = 0.001*0.5773;
+    return normalize(
+        k.xyy*map(p + k.xyy*h) +
+        k.yyx*map(p + k.yyx*h) +
+        k.yxy*map(p + k.yxy*h) +
+        k.xxx*map(p + k.xxx*h)
+    );
+}
+#else
 // numerical normal: https://iquilezles.org/articles/normalsSDF/
 vec3 normal(vec3 p){
     vec2 h = vec2(0.001, 0.);
@@ -49,16 +199,52 @@ vec3 normal(vec3 p){
         map(p+h.yyx) - map(p-h.yyx)
     ));
 }
+#endif
+
+// Interleaved rendering: pixel of the frame of pixel c of the compact image
+ivec2 interleaved_pixel(ivec2 c) {
+    ivec2 o = ivec2(interleave.xy);
+    int h = int(interleave.z);
+    return ivec2(2*c.x + ((o.x + c.y*(2 - h)) & 1), h*c.y + o.y);
+}
 
 void main()
 {
-    vec2 uv = gl_FragCoord.xy/params.xy;
+    vec3 ro = vec3(0.,0.,-5.);
+
+    if(params.w > 0.){
+        // Cone pass, a pixel per tile: the cone of its center ray contains
+        // the rays of the tile's pixels, up to the half diagonal of the tile
+        // away at distance 1
+        vec2 uv = gl_FragCoord.xy*params.w/params.xy - 0.5;
+        uv.x *= params.x/params.y;
+        float k = params.w*0.7072/params.y;
+        outCol = vec4(conemarch(ro, normalize(vec3(uv, 1.)), k));
+        #ifdef HEATMAP
+        // The tile's evaluations, shared by its pixels in the main pass
+        outCol.g = float(mapCalls);
+        atomicAdd(coneMapCalls, uint(mapCalls));
+        #endif
+        return;
+    }
+
+    vec2 fragCoord = gl_FragCoord.xy;
+    if(interleave.w == 1.){
+        fragCoord = vec2(interleaved_pixel(ivec2(fragCoord))) + 0.5;
+    }
+    vec2 uv = fragCoord/params.xy;
     uv -= 0.5;
     uv.x *= params.x/params.y;
 
-    vec3 ro = vec3(0.,0.,-5.);
     vec3 rd = normalize(vec3(uv, 1.));
-    float t = raymarch(ro, rd);
+    float tStart = 0.;
+    float coneCalls = 0.; // share of the tile's cone pass evaluations
+    if(params.w < 0.){
+        vec2 cone = texelFetch(coneStarts, ivec2(fragCoord) / int(-params.w), 0).rg;
+        tStart = cone.x;
+        coneCalls = cone.y/(params.w*params.w);
+    }
+    float t = raymarch(ro, rd, tStart);
 
     vec3 col = vec3(0.5,0.6,0.7); // sky color
     if(t > 0.){
@@ -75,5 +261,17 @@ void main()
     }
 
     col = pow(col, vec3(1./2.2)); // gamma correction
-    outCol = vec4(col, 1.);
+
+    #ifdef HEATMAP
+    // Color by map() evaluations, rays running out of steps are striped
+    col = heat((float(mapCalls) + coneCalls) / 40.);
+    if(outOfSteps && mod(fragCoord.x + fragCoord.y, 8.) < 4.){
+        col *= 0.5;
+    }
+    atomicAdd(stepsHistogram[steps], 1u);
+    atomicAdd(mapCallsHistogram[min(mapCalls, 63)], 1u);
+    atomicAdd(outcomes[t > 0. ? 0 : (outOfSteps ? 2 : 1)], 1u);
+    #endif
+
+    outCol = vec4(col, interleave.w == 1. ? t : 1.);
 }
\ No newline at end of file
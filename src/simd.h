@@ -0,0 +1,152 @@
+#pragma once
+
+// Minimal vector abstraction shared by the CPU ports of the shaders, so
+// they are written once for both SSE2 and AVX2 (when the compiler
+// targets it). A vfloat holds VWIDTH lanes, masks are all ones or zeros.
+
+#include <immintrin.h>
+
+#ifdef __AVX2__
+#define VWIDTH 8
+typedef __m256 vfloat;
+typedef __m256i vint;
+#define vset(x) _mm256_set1_ps(x)
+#define vload _mm256_loadu_ps
+#define vstore _mm256_storeu_ps
+#define vadd _mm256_add_ps
+#define vsub _mm256_sub_ps
+#define vmul _mm256_mul_ps
+#define vdiv _mm256_div_ps
+#define vsqrt _mm256_sqrt_ps
+#define vmin _mm256_min_ps
+#define vmax _mm256_max_ps
+#define vand _mm256_and_ps
+#define vandnot _mm256_andnot_ps
+#define vor _mm256_or_ps
+#define vxor _mm256_xor_ps
+#define vcmplt(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define vcmpgt(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define vmovemask _mm256_movemask_ps
+#define vtofloat _mm256_cvtepi32_ps
+#define vtoint _mm256_cvttps_epi32
+#define vasfloat _mm256_castsi256_ps
+#define viset(x) _mm256_set1_epi32(x)
+#define viadd _mm256_add_epi32
+#define visub _mm256_sub_epi32
+#define viand _mm256_and_si256
+#define viandnot _mm256_andnot_si256
+#define vicmpeq _mm256_cmpeq_epi32
+#define vislli _mm256_slli_epi32
+#define VLANES _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+#else
+#define VWIDTH 4
+typedef __m128 vfloat;
+typedef __m128i vint;
+#define vset(x) _mm_set1_ps(x)
+#define vload _mm_loadu_ps
+#define vstore _mm_storeu_ps
+#define vadd _mm_add_ps
+#define vsub _mm_sub_ps
+#define vmul _mm_mul_ps
+#define vdiv _mm_div_ps
+#define vsqrt _mm_sqrt_ps
+#define vmin _mm_min_ps
+#define vmax _mm_max_ps
+#define vand _mm_and_ps
+#define vandnot _mm_andnot_ps
+#define vor _mm_or_ps
+#define vxor _mm_xor_ps
+#define vcmplt _mm_cmplt_ps
+#define vcmpgt _mm_cmpgt_ps
+#define vmovemask _mm_movemask_ps
+#define vtofloat _mm_cvtepi32_ps
+#define vtoint _mm_cvttps_epi32
+#define vasfloat _mm_castsi128_ps
+#define viset(x) _mm_set1_epi32(x)
+#define viadd _mm_add_epi32
+#define visub _mm_sub_epi32
+#define viand _mm_and_si128
+#define viandnot _mm_andnot_si128
+#define vicmpeq _mm_cmpeq_epi32
+#define vislli _mm_slli_epi32
+#define VLANES _mm_setr_epi32(0, 1, 2, 3)
+#endif
+
+// Integer lanes in the same registers as vint, 2*VWIDTH lanes of 16 bits.
+// vipack32 saturates 32 bits lanes to signed 16 bits and vipack16 16 bits
+// lanes to unsigned 8 bits, keeping lanes in order (AVX2 packs interleave
+// the 128 bits halves of their operands).
+#ifdef __AVX2__
+#define viload(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vistore(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+#define vistore_half(p, x) _mm_storeu_si128((__m128i*)(p), _mm256_castsi256_si128(x))
+#define visrli _mm256_srli_epi32
+#define vimadd16 _mm256_madd_epi16
+#define viset16(x) _mm256_set1_epi16(x)
+#define viadd16 _mm256_add_epi16
+#define visub16 _mm256_sub_epi16
+#define vimul16 _mm256_mullo_epi16
+#define visrli16 _mm256_srli_epi16
+#define vipack32(a, b) _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8)
+#define vipack16(a, b) _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8)
+#else
+#define viload(p) _mm_loadu_si128((const __m128i*)(p))
+#define vistore(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define vistore_half(p, x) _mm_storel_epi64((__m128i*)(p), x)
+#define visrli _mm_srli_epi32
+#define vimadd16 _mm_madd_epi16
+#define viset16(x) _mm_set1_epi16(x)
+#define viadd16 _mm_add_epi16
+#define visub16 _mm_sub_epi16
+#define vimul16 _mm_mullo_epi16
+#define visrli16 _mm_srli_epi16
+#define vipack32 _mm_packs_epi32
+#define vipack16 _mm_packus_epi16
+#endif
+
+// mask ? a : b
+static inline vfloat vselect(vfloat mask, vfloat a, vfloat b) {
+    return vor(vand(mask, a), vandnot(mask, b));
+}
+
+static inline vfloat vabs(vfloat x) {
+    return vandnot(vasfloat(viset(0x80000000)), x);
+}
+
+// Sine and cosine, from the Cephes library: reduction to [-pi/4, pi/4]
+// with an extended precision pi/4, then minimax polynomials.
+// Absolute error stays below 1e-6 for |x| < 8192*pi.
+static inline void vsincos(vfloat x, vfloat* s, vfloat* c) {
+    const vfloat signBit = vasfloat(viset(0x80000000));
+    vfloat sinSign = vand(x, signBit);
+    x = vandnot(signBit, x);
+
+    // Octant of x, rounded up to an even one
+    vint j = vtoint(vmul(x, vset(1.27323954473516f))); // 4/pi
+    j = viand(viadd(j, viset(1)), viset(~1));
+    vfloat y = vtofloat(j);
+
+    sinSign = vxor(sinSign, vasfloat(vislli(viand(j, viset(4)), 29)));
+    vfloat cosSign = vasfloat(vislli(viandnot(visub(j, viset(2)), viset(4)), 29));
+    // Octants where the sine polynomial gives the sine (and not the cosine)
+    vfloat sinPoly = vasfloat(vicmpeq(viand(j, viset(2)), viset(0)));
+
+    x = vadd(x, vmul(y, vset(-0.78515625f)));
+    x = vadd(x, vmul(y, vset(-2.4187564849853515625e-4f)));
+    x = vadd(x, vmul(y, vset(-3.77489497744594108e-8f)));
+    vfloat z = vmul(x, x);
+
+    vfloat pc = vset(2.443315711809948e-5f);
+    pc = vadd(vmul(pc, z), vset(-1.388731625493765e-3f));
+    pc = vadd(vmul(pc, z), vset(4.166664568298827e-2f));
+    pc = vmul(vmul(pc, z), z);
+    pc = vadd(vsub(pc, vmul(z, vset(0.5f))), vset(1.f));
+
+    vfloat ps = vset(-1.9515295891e-4f);
+    ps = vadd(vmul(ps, z), vset(8.3321608736e-3f));
+    ps = vadd(vmul(ps, z), vset(-1.6666654611e-1f));
+    ps = vadd(vmul(vmul(ps, z), x), x);
+
+    *s = vxor(vadd(vand(sinPoly, ps), vandnot(sinPoly, pc)), sinSign);
+    *c = vxor(vadd(vand(sinPoly, pc), vandnot(sinPoly, ps)), cosSign);
+}
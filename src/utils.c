@@ -1,9 +1,11 @@
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include "platform.h"
 #include <malloc.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <timeapi.h>
 #include <GL/gl.h>
-#include "glext.h"
+#include "gl_functions.h"
 #include "utils.h"
 
 
@@ -141,6 +143,170 @@ char* load_file(const char* path, PDWORD loadedSize) {
     return buffer;
 }
 
+HANDLE create_file(const char* path) {
+    return CreateFile(
+        path,
+        GENERIC_WRITE,
+        0,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+}
+
+BOOL start_process(char* cmd, PHANDLE stdinWrite, PHANDLE process) {
+    STARTUPINFO si = {0};
+    si.cb = sizeof(si);
+
+    HANDLE stdinRead = NULL;
+    if(stdinWrite) {
+        SECURITY_ATTRIBUTES sa = {0};
+        sa.nLength = sizeof(sa);
+        sa.bInheritHandle = TRUE;
+
+        if(!CreatePipe(&stdinRead, stdinWrite, &sa, 0)) {
+            return FALSE;
+        }
+        // Only the read end of the pipe is inherited by the child
+        if(!SetHandleInformation(*stdinWrite, HANDLE_FLAG_INHERIT, 0)) {
+            return FALSE;
+        }
+
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput  = stdinRead;
+        si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        si.hStdError  = GetStdHandle(STD_ERROR_HANDLE);
+    }
+
+    PROCESS_INFORMATION pi = {0};
+    BOOL ok = CreateProcess(
+        NULL, cmd,
+        NULL, NULL,
+        stdinWrite != NULL, // inherit the pipe's read end
+        CREATE_NO_WINDOW,
+        NULL, NULL,
+        &si, &pi);
+
+    if(stdinRead) {
+        CloseHandle(stdinRead);
+    }
+    if(!ok) {
+        return FALSE;
+    }
+
+    CloseHandle(pi.hThread);
+    *process = pi.hProcess;
+    return TRUE;
+}
+
+DWORD wait_process(HANDLE process) {
+    WaitForSingleObject(process, INFINITE);
+
+    DWORD exitCode = 0;
+    GetExitCodeProcess(process, &exitCode);
+    CloseHandle(process);
+    return exitCode;
+}
+
+BOOL get_executable_path(char* path, DWORD size) {
+    DWORD length = GetModuleFileName(NULL, path, size);
+    return length != 0 && length < size;
+}
+
+HANDLE start_thread(LPTHREAD_START_ROUTINE proc, LPVOID arg) {
+    HANDLE thread = CreateThread(NULL, 0, proc, arg, 0, NULL);
+    if(!thread) {
+        ERROR_EXIT();
+    }
+    return thread;
+}
+
+void join_thread(HANDLE thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+HANDLE create_semaphore(LONG initialCount) {
+    HANDLE semaphore = CreateSemaphore(NULL, initialCount, MAXLONG, NULL);
+    if(!semaphore) {
+        ERROR_EXIT();
+    }
+    return semaphore;
+}
+
+void wait_semaphore(HANDLE semaphore) {
+    WaitForSingleObject(semaphore, INFINITE);
+}
+
+void release_semaphore(HANDLE semaphore) {
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+void delete_semaphore(HANDLE semaphore) {
+    CloseHandle(semaphore);
+}
+
+#define MAX_WORKERS 64
+
+void run_workers(LPTHREAD_START_ROUTINE proc, LPVOID arg) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    DWORD numWorkers = min(si.dwNumberOfProcessors, MAX_WORKERS);
+
+    HANDLE workers[MAX_WORKERS];
+    for(DWORD i = 0; i < numWorkers; i++) {
+        workers[i] = start_thread(proc, arg);
+    }
+    WaitForMultipleObjects(numWorkers, workers, TRUE, INFINITE);
+    for(DWORD i = 0; i < numWorkers; i++) {
+        CloseHandle(workers[i]);
+    }
+}
+
+double get_time(void) {
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+static HANDLE sleepTimer;
+
+void sleep_seconds(double seconds) {
+    if(!sleepTimer) {
+        // High resolution timers need Windows 10 1803, otherwise raise the
+        // system timer resolution from 15.6 ms to 1 ms for regular ones
+        sleepTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if(!sleepTimer) {
+            timeBeginPeriod(1);
+            sleepTimer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+        }
+    }
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(LONGLONG)(seconds * 1e7); // relative, in 100 ns units
+    SetWaitableTimer(sleepTimer, &dueTime, 0, NULL, NULL, FALSE);
+    WaitForSingleObject(sleepTimer, INFINITE);
+}
+
+void log_printf(const char* format, ...) {
+    char msg[1024];
+    va_list args;
+    va_start(args, format);
+    vsprintf_s(msg, sizeof(msg), format, args);
+    va_end(args);
+
+    // Windowed builds have no console attached
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    if(!hConsole || !write_file(hConsole, msg, (DWORD)strlen(msg), NULL)) {
+        OutputDebugString(msg);
+    }
+}
+
 char* load_shader(const char* filename) {
     char path[256];
     sprintf_s(path, sizeof(path), ".\\src\\shaders\\%s", filename);
@@ -154,9 +320,46 @@ char* load_shader(const char* filename) {
     return source;
 }
 
-#define glGetProgramiv ((PFNGLGETPROGRAMIVPROC)wglGetProcAddress("glGetProgramiv"))
-#define glGetProgramInfoLog ((PFNGLGETPROGRAMINFOLOGPROC)wglGetProcAddress("glGetProgramInfoLog"))
+#ifdef HOT_RELOAD
+void watch_shaders_directory(void (*modified)(const char* filename)) {
+    HANDLE dir = CreateFile(
+        ".\\src\\shaders",
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS, // needed to open a directory
+        NULL
+    );
+    if(dir == INVALID_HANDLE_VALUE) {
+        ERROR_EXIT();
+    }
+
+    // Editors either write files in place or replace them with a renamed
+    // temporary file
+    DWORD notifications[1024]; // FILE_NOTIFY_INFORMATION are DWORD aligned
+    DWORD size;
+    while(ReadDirectoryChangesW(dir, notifications, sizeof(notifications), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, &size, NULL, NULL)) {
+        BYTE* next = (BYTE*)notifications;
+        while(size > 0) { // 0 if notifications were lost
+            FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)next;
+            char filename[MAX_PATH];
+            int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName,
+                info->FileNameLength / sizeof(WCHAR), filename, sizeof(filename) - 1, NULL, NULL);
+            filename[length] = '\0';
+            modified(filename);
+            if(!info->NextEntryOffset) {
+                break;
+            }
+            next += info->NextEntryOffset;
+        }
+    }
+    ERROR_EXIT();
+}
+#endif
 
+#ifndef TINY
 BOOL check_shader(GLuint shader) {
     GLuint result;
     glGetProgramiv(shader, GL_LINK_STATUS, &result);
@@ -175,3 +378,4 @@ BOOL check_shader(GLuint shader) {
     }
     return TRUE;
 }
+#endif
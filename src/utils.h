@@ -1,7 +1,6 @@
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include "platform.h"
 #include <GL/gl.h>
 
 const char* base_name(const char* path);
@@ -16,6 +15,39 @@ void error_exit(const char* file, int line);
 BOOL write_file(HANDLE hFile, LPCVOID data, DWORD nbBytes, PDWORD nbWrittenTotal);
 BOOL read_file(HANDLE hFile, LPVOID buffer, DWORD nbBytes, PDWORD nbReadTotal);
 char* load_file(const char* path, PDWORD loadedSize);
+// Creates or truncates a file for writing
+HANDLE create_file(const char* path);
+
+// Runs a command line in a child process. If stdinWrite is not NULL, the
+// child's standard input is connected to a pipe whose write end is returned.
+BOOL start_process(char* cmd, PHANDLE stdinWrite, PHANDLE process);
+// Waits for a child process to finish, returns its exit code
+DWORD wait_process(HANDLE process);
+// Full path of the running executable
+BOOL get_executable_path(char* path, DWORD size);
+
+// Runs proc(arg) on a new thread
+HANDLE start_thread(LPTHREAD_START_ROUTINE proc, LPVOID arg);
+// Waits for a thread to finish and releases it
+void join_thread(HANDLE thread);
+// Counting semaphores, to hand buffers over between threads
+HANDLE create_semaphore(LONG initialCount);
+void wait_semaphore(HANDLE semaphore);
+void release_semaphore(HANDLE semaphore);
+void delete_semaphore(HANDLE semaphore);
+// Runs proc(arg) on one thread per processor and waits for all of them
+void run_workers(LPTHREAD_START_ROUTINE proc, LPVOID arg);
+
+// High resolution time in seconds, from an arbitrary origin
+double get_time(void);
+// Sleeps for about the given time in seconds, with a sub-millisecond
+// resolution where the system allows it
+void sleep_seconds(double seconds);
+// Prints to the console if any, or to the debugger output
+void log_printf(const char* format, ...);
 
 char* load_shader(const char* filename);
+// Blocks forever, calling modified() with the name of every file of the
+// shaders directory modified or replaced
+void watch_shaders_directory(void (*modified)(const char* filename));
 BOOL check_shader(GLuint shader);